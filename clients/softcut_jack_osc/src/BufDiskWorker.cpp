@@ -25,6 +25,7 @@ std::array<BufDiskWorker::BufDesc, BufDiskWorker::maxBufs> BufDiskWorker::bufs;
 int BufDiskWorker::numBufs = 0;
 bool BufDiskWorker::shouldQuit = false;
 int BufDiskWorker::sampleRate = 48000;
+std::function<void(const float *data)> BufDiskWorker::changedCallback;
 
 
 // clamp unsigned int to upper bound, inclusive
@@ -40,6 +41,10 @@ int BufDiskWorker::registerBuffer(float *data, size_t frames) {
     return n;
 }
 
+void BufDiskWorker::setChangedCallback(std::function<void(const float *data)> f) {
+    changedCallback = std::move(f);
+}
+
 void BufDiskWorker::requestJob(BufDiskWorker::Job &job) {
     qMut.lock();
     jobQ.push(job);
@@ -90,13 +95,19 @@ void BufDiskWorker::workLoop() {
             switch (job.type) {
                 case JobType::Clear:
                     clearBuffer(bufs[job.bufIdx[0]], job.startDst, job.dur);
+                    if (changedCallback) { changedCallback(bufs[job.bufIdx[0]].data); }
                     break;
                 case JobType::ReadMono:
                     readBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.startDst, job.dur, job.chan);
+                    if (changedCallback) { changedCallback(bufs[job.bufIdx[0]].data); }
                     break;
                 case JobType::ReadStereo:
                     readBufferStereo(job.path, bufs[job.bufIdx[0]], bufs[job.bufIdx[1]], job.startSrc, job.startDst,
                                      job.dur);
+                    if (changedCallback) {
+                        changedCallback(bufs[job.bufIdx[0]].data);
+                        changedCallback(bufs[job.bufIdx[1]].data);
+                    }
                     break;
                 case JobType::WriteMono:
                     writeBufferMono(job.path, bufs[job.bufIdx[0]], job.startSrc, job.dur);
@@ -16,6 +16,7 @@
 #define CRONE_BUFMANAGER_H
 
 #include <atomic>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <queue>
@@ -54,6 +55,7 @@ namespace softcut_jack_osc {
         static constexpr int sleepPeriodMs = 100;
         static int sampleRate;
         static constexpr int ioBufFrames = 1024;
+        static std::function<void(const float *data)> changedCallback;
 
         static int secToFrame(float seconds);
 
@@ -68,6 +70,9 @@ namespace softcut_jack_osc {
         // returns index to be used in work requests
         static int registerBuffer(float *data, size_t frames);
 
+        // set a function to call (on the worker thread) after a job changes a buffer's contents
+        static void setChangedCallback(std::function<void(const float *data)> f);
+
         // clear a portion of a mono buffer
         static void requestClear(size_t idx, float start = 0, float dur = -1);
 
@@ -81,6 +81,11 @@ namespace softcut_jack_osc {
         // mix from bus, with smoothed amplitude
         void mixFrom(BusT &b, size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
+            if (level.isSettled()) {
+                const float l = level.getValue();
+                if (l != 0.f) { mixFrom(b, numFrames, l); }
+                return;
+            }
             float l;
             for(size_t fr=0; fr<numFrames; ++fr) {
                 l = level.update();
@@ -93,6 +98,16 @@ namespace softcut_jack_osc {
         // apply smoothed amplitude
         void applyGain(size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
+            if (level.isSettled()) {
+                const float l = level.getValue();
+                if (l == 1.f) { return; }
+                for(size_t ch=0; ch<NumChannels; ++ch) {
+                    for(size_t fr=0; fr<numFrames; ++fr) {
+                        buf[ch][fr] *= l;
+                    }
+                }
+                return;
+            }
             float l;
             for(size_t fr=0; fr<numFrames; ++fr) {
                 l = level.update();
@@ -105,6 +120,16 @@ namespace softcut_jack_osc {
         // mix from pointer array, with smoothed amplitude
         void mixFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
+            if (level.isSettled()) {
+                const float l = level.getValue();
+                if (l == 0.f) { return; }
+                for(size_t ch=0; ch<NumChannels; ++ch) {
+                    for(size_t fr=0; fr<numFrames; ++fr) {
+                        buf[ch][fr] += src[ch][fr] * l;
+                    }
+                }
+                return;
+            }
             float l;
             for(size_t fr=0; fr<numFrames; ++fr) {
                 l = level.update();
@@ -117,6 +142,15 @@ namespace softcut_jack_osc {
         // set from pointer array, with smoothed amplitude
         void setFrom(const float *src[NumChannels], size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
+            if (level.isSettled()) {
+                const float l = level.getValue();
+                for(size_t ch=0; ch<NumChannels; ++ch) {
+                    for(size_t fr=0; fr<numFrames; ++fr) {
+                        buf[ch][fr] = src[ch][fr] * l;
+                    }
+                }
+                return;
+            }
             float l;
             for(size_t fr=0; fr<numFrames; ++fr) {
                 l = level.update();
@@ -139,6 +173,15 @@ namespace softcut_jack_osc {
         // mix to pointer array, with smoothed amplitude
         void mixTo(float *dst[NumChannels], size_t numFrames, LogRamp &level) {
             BOOST_ASSERT(numFrames < BlockSize);
+            if (level.isSettled()) {
+                const float l = level.getValue();
+                for(size_t ch=0; ch<NumChannels; ++ch) {
+                    for(size_t fr=0; fr<numFrames; ++fr) {
+                        dst[ch][fr] = buf[ch][fr] * l;
+                    }
+                }
+                return;
+            }
             float l;
             for(size_t fr=0; fr<numFrames; ++fr) {
                 l = level.update();
@@ -188,10 +231,17 @@ namespace softcut_jack_osc {
         }
 
         // mix from mono->stereo bus, with level and pan (linear)
-        void panMixFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
+        void panMixFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp& pan) {
             BOOST_ASSERT(numFrames < BlockSize);
             static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
             float l, c, x;
+            if (level.isSettled() && pan.isSettled()) {
+                l = level.getValue();
+                if (l == 0.f) { return; }
+                c = pan.getValue();
+                panMixConst(a, numFrames, l*(1.f-c), l*c);
+                return;
+            }
             for(size_t fr=0; fr<numFrames; ++fr) {
                 x = a.buf[0][fr];
                 l = level.update();
@@ -203,10 +253,17 @@ namespace softcut_jack_osc {
 
 
         // mix from mono->stereo bus, with level and pan (equal power)
-        void panMixEpFrom(Bus<1, BlockSize> a, size_t numFrames, LogRamp &level, LogRamp& pan) {
+        void panMixEpFrom(const Bus<1, BlockSize> &a, size_t numFrames, LogRamp &level, LogRamp& pan) {
             BOOST_ASSERT(numFrames < BlockSize);
             static_assert(NumChannels > 1, "using panMixFrom() on mono bus");
             float l, c, x;
+            if (level.isSettled() && pan.isSettled()) {
+                l = level.getValue();
+                if (l == 0.f) { return; }
+                c = pan.getValue() * (float)M_PI_2;
+                panMixConst(a, numFrames, l * cosf(c), l * sinf(c));
+                return;
+            }
             for(size_t fr=0; fr<numFrames; ++fr) {
                 x = a.buf[0][fr];
                 l = level.update();
@@ -217,6 +274,14 @@ namespace softcut_jack_osc {
             }
         }
 
+    private:
+        // mix from mono->stereo bus with fixed left/right gains
+        void panMixConst(const Bus<1, BlockSize> &a, size_t numFrames, float gl, float gr) {
+            for(size_t fr=0; fr<numFrames; ++fr) {
+                buf[0][fr] += a.buf[0][fr] * gl;
+                buf[1][fr] += a.buf[0][fr] * gr;
+            }
+        }
 
     };
 
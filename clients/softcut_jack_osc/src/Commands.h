@@ -63,6 +63,10 @@ namespace softcut_jack_osc {
             SET_CUT_RECPRE_SLEW_TIME,
             SET_CUT_RATE_SLEW_TIME,
             SET_CUT_VOICE_SYNC,
+            SET_CUT_VOICE_FOLLOW,
+            SET_CUT_VOICE_DUCK,
+            SET_CUT_DUCK_WINDOW,
+            SET_CUT_INTERPOLATION,
             SET_CUT_BUFFER,
             NUM_COMMANDS,
         } Id;
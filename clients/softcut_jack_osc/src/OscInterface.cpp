@@ -313,6 +313,29 @@ void OscInterface::addServerMethods() {
         Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_SYNC, argv[0]->i, argv[1]->i, argv[2]->f);
     });
 
+    // voice, leader voice (-1 to stop following)
+    addServerMethod("/set/param/cut/voice_follow", "ii", [](lo_arg **argv, int argc) {
+        if (argc < 2) { return; }
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_FOLLOW, argv[0]->i, argv[1]->i);
+    });
+
+    // voice, reference voice (-1 to stop ducking)
+    addServerMethod("/set/param/cut/voice_duck", "ii", [](lo_arg **argv, int argc) {
+        if (argc < 2) { return; }
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_VOICE_DUCK, argv[0]->i, argv[1]->i);
+    });
+
+    addServerMethod("/set/param/cut/duck_window", "if", [](lo_arg **argv, int argc) {
+        if (argc < 2) { return; }
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_DUCK_WINDOW, argv[0]->i, argv[1]->f);
+    });
+
+    // voice, quality (0 = linear, 1 = hermite, 2 = windowed sinc)
+    addServerMethod("/set/param/cut/interpolation", "ii", [](lo_arg **argv, int argc) {
+        if (argc < 2) { return; }
+        Commands::softcutCommands.post(Commands::Id::SET_CUT_INTERPOLATION, argv[0]->i, argv[1]->i);
+    });
+
     addServerMethod("/set/param/cut/level_slew_time", "if", [](lo_arg **argv, int argc) {
         if (argc < 2) { return; }
         Commands::softcutCommands.post(Commands::Id::SET_CUT_LEVEL_SLEW_TIME, argv[0]->i, argv[1]->f);
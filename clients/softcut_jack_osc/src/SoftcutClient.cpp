@@ -2,6 +2,8 @@
 // Created by emb on 11/28/18.
 //
 
+#include <algorithm>
+
 #include <sndfile.hh>
 
 #include "BufDiskWorker.h"
@@ -22,19 +24,28 @@ SoftcutClient::SoftcutClient() : JackClient<2, 2>("softcut") {
     }
     bufIdx[0] = BufDiskWorker::registerBuffer(buf[0], BufFrames);
     bufIdx[1] = BufDiskWorker::registerBuffer(buf[1], BufFrames);
-
+    BufDiskWorker::setChangedCallback([this](const float *data) { cut.markBufferChanged(data); });
 }
 
 void SoftcutClient::process(jack_nframes_t numFrames) {
     Commands::softcutCommands.handlePending(this);
+    // no voices enabled: output silence without touching the busses
+    if (std::none_of(enabled, enabled + NumVoices, [](bool e) { return e; })) {
+        for (int ch = 0; ch < 2; ++ch) {
+            std::fill(sink[0][ch], sink[0][ch] + numFrames, 0.f);
+        }
+        return;
+    }
     clearBusses(numFrames);
     mixInput(numFrames);
     // process softcuts (overwrites output bus)
+    const float *in[NumVoices];
+    float *out[NumVoices];
     for (int v = 0; v < NumVoices; ++v) {
-        if (enabled[v]) {
-            cut.processBlock(v, input[v].buf[0], output[v].buf[0], static_cast<int>(numFrames));
-        }
+        in[v] = enabled[v] ? input[v].buf[0] : nullptr;
+        out[v] = output[v].buf[0];
     }
+    cut.processBlocks(in, out, static_cast<int>(numFrames));
     mixOutput(numFrames);
     mix.copyTo(sink[0], numFrames);
 }
@@ -52,12 +63,12 @@ void SoftcutClient::clearBusses(size_t numFrames) {
 
 void SoftcutClient::mixInput(size_t numFrames) {
     for (int dst = 0; dst < NumVoices; ++dst) {
-        if (cut.getRecFlag(dst)) {
+        if (enabled[dst] && cut.getRecFlag(dst)) {
             for (int ch = 0; ch < 2; ++ch) {
                 input[dst].mixFrom(&source[SourceAdc][ch], numFrames, inLevel[ch][dst]);
             }
             for (int src = 0; src < NumVoices; ++src) {
-                if (cut.getPlayFlag(src)) {
+                if (enabled[src] && cut.getPlayFlag(src)) {
                     input[dst].mixFrom(output[src], numFrames, fbLevel[src][dst]);
                 }
             }
@@ -67,7 +78,7 @@ void SoftcutClient::mixInput(size_t numFrames) {
 
 void SoftcutClient::mixOutput(size_t numFrames) {
     for (int v = 0; v < NumVoices; ++v) {
-        if (cut.getPlayFlag(v)) {
+        if (enabled[v] && cut.getPlayFlag(v)) {
             mix.panMixEpFrom(output[v], numFrames, outLevel[v], outPan[v]);
         }
     }
@@ -188,6 +199,18 @@ void SoftcutClient::handleCommand(Commands::CommandPacket *p) {
         case Commands::Id::SET_CUT_VOICE_SYNC:
             cut.syncVoice(p->idx_0, p->idx_1, p->value);
             break;
+        case Commands::Id::SET_CUT_VOICE_FOLLOW:
+            cut.setFollow(p->idx_0, p->idx_1);
+            break;
+        case Commands::Id::SET_CUT_VOICE_DUCK:
+            cut.setDuck(p->idx_0, p->idx_1);
+            break;
+        case Commands::Id::SET_CUT_DUCK_WINDOW:
+            cut.setDuckWindow(p->idx_0, p->value);
+            break;
+        case Commands::Id::SET_CUT_INTERPOLATION:
+            cut.setInterpolation(p->idx_0, p->idx_1);
+            break;
         case Commands::Id::SET_CUT_BUFFER:
             cut.setVoiceBuffer(p->idx_0, buf[p->idx_1], BufFrames);
             break;
@@ -111,6 +111,17 @@ namespace softcut_jack_osc {
 
         int getNumVoices() const { return NumVoices; }
 
+        // threads used to process voices (1 by default).
+        // voices on the two buffers are independent, so up to two are useful;
+        // workers spin on a core of their own while the client runs.
+        // call before start()
+        void setNumThreads(int n) { cut.setNumThreads(n); }
+
+        // octaves of decimated buffer copies, for cleaner reads at high rates (none by default).
+        // 3 covers rates up to 16, for about 112MB more memory and a background thread.
+        // call before start()
+        void setMipLevels(int n) { cut.setMipLevels(n); }
+
         float getSampleRate() const { return sampleRate; }
 
 	void reset();
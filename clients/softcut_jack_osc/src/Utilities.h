@@ -139,13 +139,17 @@ namespace softcut_jack_osc {
 
     // logarithmic interpolator (aka 1-pole LPF)
     class LogRamp {
+        // output snaps to target when within this distance
+        static constexpr float settleThreshold = 1e-6f;
         float sampleRate;
         float time;
         float b;
         float x0;
         float y0;
+        // set when output has reached target
+        bool settled;
     public:
-        explicit LogRamp(float sr=48000, float t=0.05) : sampleRate(sr), b(1.f), x0(0.f), y0(0.f) {
+        explicit LogRamp(float sr=48000, float t=0.05) : sampleRate(sr), b(1.f), x0(0.f), y0(0.f), settled(true) {
             sampleRate = sr;
             time = t;
             setTime(t);
@@ -167,14 +171,42 @@ namespace softcut_jack_osc {
         // update input only
         void setTarget(float x) {
             x0 = x;
+            settled = (x0 == y0);
         }
 
         // update output only
         float update() {
-            y0 = smooth1pole(x0, y0, b);
+            if (!settled) {
+                const float y = smooth1pole(x0, y0, b);
+                // also settle if rounding has stalled convergence
+                if (std::fabs(x0 - y) < settleThreshold || y == y0) {
+                    y0 = x0;
+                    settled = true;
+                } else {
+                    y0 = y;
+                }
+            }
             return y0;
         }
 
+        // update output for a block of frames.
+        // if the ramp is settled, output is constant for the block:
+        // nothing is written, and this returns true (use getValue()).
+        // otherwise, output is written to buf and this returns false.
+        bool updateBlock(float *buf, int numFrames) {
+            if (settled) {
+                return true;
+            }
+            int i = 0;
+            while (i < numFrames && !settled) {
+                buf[i++] = update();
+            }
+            while (i < numFrames) {
+                buf[i++] = y0;
+            }
+            return false;
+        }
+
         // update input and output
         float process(float x) {
             setTarget(x);
@@ -185,6 +217,15 @@ namespace softcut_jack_osc {
             return x0;
         }
 
+        // current output
+        float getValue() const {
+            return y0;
+        }
+
+        bool isSettled() const {
+            return settled;
+        }
+
     };
 
     // a smoother with separate rise and fall times
@@ -4,9 +4,12 @@
 
 #include <iostream>
 #include <chrono>
+#include <cstdlib>
 #include <thread>
 #include <memory>
 
+#include <unistd.h>
+
 #include "SoftcutClient.h"
 #include "OscInterface.h"
 #include "BufDiskWorker.h"
@@ -15,13 +18,34 @@ static inline void sleep(int ms) {
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
-int main() {
+int main(int argc, char **argv) {
     using namespace softcut_jack_osc;
     using std::cout;
     using std::endl;
 
+    // -t <threads>: process voices on more than one thread (off by default, to save power)
+    // -m <levels>: keep decimated buffer copies for high rates (off by default, to save memory)
+    int numThreads = 1;
+    int mipLevels = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:m:")) != -1) {
+        switch (opt) {
+            case 't':
+                numThreads = atoi(optarg);
+                break;
+            case 'm':
+                mipLevels = atoi(optarg);
+                break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-t threads] [-m mip levels]" << endl;
+                return 1;
+        }
+    }
+
     std::unique_ptr<SoftcutClient> sc;
     sc = std::make_unique<SoftcutClient>();
+    sc->setNumThreads(numThreads);
+    sc->setMipLevels(mipLevels);
 
     sc->setup();
     BufDiskWorker::init(static_cast<float>(sc->getSampleRate()));
@@ -0,0 +1,90 @@
+//
+// cycles (or nanoseconds) per sample of one voice, in each play/record mode.
+//
+// usage: softcut_bench [block size] [rate]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SOFTCUT_BENCH_CYCLES 1
+#endif
+
+#include "softcut/Voice.h"
+
+using namespace softcut;
+
+namespace {
+    // a power of 2, longer than the loop
+    static constexpr unsigned int bufFrames = 1u << 22;
+    float buf[bufFrames];
+
+    unsigned long long now() {
+#if SOFTCUT_BENCH_CYCLES
+        return __rdtsc();
+#else
+        return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+}
+
+int main(int argc, char **argv) {
+    const int blockSize = argc > 1 ? atoi(argv[1]) : 128;
+    const float rate = argc > 2 ? static_cast<float>(atof(argv[2])) : 1.f;
+    if (blockSize < 1) {
+        fprintf(stderr, "usage: %s [block size] [rate]\n", argv[0]);
+        return 1;
+    }
+
+    const char *names[] = {"idle", "play", "rec", "play+rec"};
+    std::vector<float> in(blockSize), out(blockSize);
+    for (int i = 0; i < blockSize; ++i) {
+        in[i] = static_cast<float>((i * 7919) % 200) / 100.f - 1.f;
+    }
+
+    printf("block size %d, rate %g\n", blockSize, rate);
+    for (int mode = 0; mode < 4; ++mode) {
+        auto *v = new Voice();
+        v->setBuffer(buf, bufFrames);
+        v->setSampleRate(48000);
+        v->setLoopStart(0);
+        v->setLoopEnd(20);
+        v->setLoopFlag(true);
+        v->setFadeTime(0.1);
+        v->setRate(rate);
+        v->setRecLevel(0.7);
+        v->setPreLevel(0.5);
+        v->setPlayFlag((mode & 1) != 0);
+        v->setRecFlag((mode & 2) != 0);
+        v->cutToPos(1.0);
+        // settle ramps and fades
+        for (int b = 0; b < 200; ++b) {
+            v->processBlockMono(in.data(), out.data(), blockSize);
+        }
+        // best of several runs, of 10 seconds each
+        const int numBlocks = 48000 * 10 / blockSize;
+        unsigned long long best = ~0ull;
+        for (int run = 0; run < 3; ++run) {
+            const unsigned long long t0 = now();
+            for (int b = 0; b < numBlocks; ++b) {
+                v->processBlockMono(in.data(), out.data(), blockSize);
+            }
+            const unsigned long long t = now() - t0;
+            best = t < best ? t : best;
+        }
+#if SOFTCUT_BENCH_CYCLES
+        const char *unit = "cycles";
+#else
+        const char *unit = "ns";
+#endif
+        printf("%-9s %7.1f %s/sample\n", names[mode],
+               static_cast<double>(best) / (static_cast<double>(numBlocks) * blockSize), unit);
+        delete v;
+    }
+    return 0;
+}
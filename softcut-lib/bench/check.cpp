@@ -0,0 +1,506 @@
+//
+// checks that the ways of processing voices agree exactly:
+// - processBlock() for each voice, and processBlocks(), with up to VoiceLanes::MaxSoloVoices voices
+// - processBlocks() on one thread, and on several
+// - two runs of the same scenario (which catches state that is never initialised)
+// - SvfBank, and Svf sample by sample
+// - a follower, and its leader (through cuts, rate changes, pauses in recording and skipped blocks)
+// - a ducking voice, and the same voice not ducking: the same away from the write head,
+//   and quieter the nearer it reads
+// - reads at each interpolation tier, and the same interpolation done here frame by frame:
+//   exactly the buffer on frames, and (for hermite, as before tiers) between them
+// - no mip levels, and levels turned on then off again
+// - a switch of mip level, and a crossfade over the block from reading the old level
+//   to reading the new one, done here frame by frame
+// - head positions against stored values, after many passes of a loop whose points fall
+//   between frames; and with SOFTCUT_FIXED_PHASE, after 8s at a rate inexact in binary
+//   (and reads on the way)
+// returns non-zero if any differ.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <chrono>
+#include <thread>
+
+#include "softcut/Mipmap.h"
+#include "softcut/Softcut.h"
+#include "softcut/SvfBank.h"
+
+using namespace softcut;
+
+namespace {
+    static constexpr int numVoices = 6;
+    static constexpr unsigned int bufFrames = 1u << 19;
+    static constexpr int blockSize = 64;
+    static constexpr int numBlocks = 48000 * 4 / blockSize;
+    float buf[numVoices][bufFrames];
+
+    enum class Mode { PerVoice, Blocks };
+
+    // run a scripted scenario on the first n voices.
+    // returns the output of each voice, followed by the start of each buffer
+    std::vector<float> runScenario(int n, Mode mode, int numThreads, bool mipsOnOff = false) {
+        auto *cut = new Softcut<numVoices>();
+        if (mipsOnOff) {
+            cut->setMipLevels(3);
+            cut->setMipLevels(0);
+        }
+        for (auto &b : buf) {
+            std::fill(b, b + bufFrames, 0.f);
+        }
+        for (int v = 0; v < numVoices; ++v) {
+            cut->setVoiceBuffer(v, buf[v], bufFrames);
+        }
+        cut->setSampleRate(48000);
+        cut->setNumThreads(numThreads);
+
+        // overdub loop
+        cut->setLoopStart(0, 0.0); cut->setLoopEnd(0, 1.0); cut->setLoopFlag(0, true);
+        cut->setRecLevel(0, 1.0); cut->setPreLevel(0, 0.5); cut->setRecFlag(0, true); cut->setPlayFlag(0, true);
+        // reverse playback, with a modulated input filter
+        cut->setLoopStart(1, 0.2); cut->setLoopEnd(1, 0.9); cut->setLoopFlag(1, true);
+        cut->setRate(1, -0.75); cut->setPlayFlag(1, true); cut->cutToPos(1, 0.5);
+        // record only, fast
+        cut->setLoopStart(2, 2.0); cut->setLoopEnd(2, 3.0); cut->setLoopFlag(2, true);
+        cut->setRate(2, 1.5); cut->setRecLevel(2, 0.8); cut->setPreLevel(2, 0.9); cut->setRecFlag(2, true);
+        // play and record, slewed rate, output filter
+        cut->setLoopStart(3, 1.0); cut->setLoopEnd(3, 1.5); cut->setLoopFlag(3, true);
+        cut->setRateSlewTime(3, 0.1); cut->setRecLevel(3, 0.5); cut->setPreLevel(3, 1.0);
+        cut->setRecFlag(3, true); cut->setPlayFlag(3, true); cut->setFadeTime(3, 0.05);
+        cut->setPostFilterLp(3, 1.0); cut->setPostFilterDry(3, 0.0); cut->setPostFilterFc(3, 2000);
+        // one-shot
+        cut->setLoopStart(4, 0.1); cut->setLoopEnd(4, 0.6); cut->setLoopFlag(4, false);
+        cut->setPlayFlag(4, true); cut->setRate(4, 2.0);
+        // record once, band-pass output
+        cut->setLoopStart(5, 3.0); cut->setLoopEnd(5, 3.25); cut->setLoopFlag(5, true);
+        cut->setRecLevel(5, 1.0); cut->setPreLevel(5, 0.0); cut->setPlayFlag(5, true); cut->setRecOnceFlag(5, true);
+        cut->setPostFilterBp(5, 0.7); cut->setPostFilterDry(5, 0.3);
+        cut->cutToPos(0, 0.0); cut->cutToPos(2, 2.0); cut->cutToPos(3, 1.0); cut->cutToPos(5, 3.0);
+
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+        std::vector<std::vector<float>> in(numVoices, std::vector<float>(blockSize));
+        std::vector<std::vector<float>> out(numVoices, std::vector<float>(blockSize));
+        std::vector<float> result;
+        double phase = 0.0;
+        for (int b = 0; b < numBlocks; ++b) {
+            if (b % 97 == 50) { cut->setRate(3, 0.5f + 1.5f * ((b / 97) % 3)); }
+            if (b % 131 == 70) { cut->cutToPos(0, 0.25f * ((b / 131) % 4)); }
+            if (b % 211 == 100) { cut->cutToPos(4, 0.15f); }
+            if (b == 900) { cut->setRecFlag(0, false); cut->setRate(0, -1.0); }
+            if (b == 1100) { cut->setPlayFlag(1, false); }
+            if (b == 1300) { cut->setPlayFlag(1, true); cut->setRecFlag(1, true); cut->setRecLevel(1, 0.3); }
+            if (b == 1000) { cut->setPreFilterLp(2, 0.5); cut->setPreFilterDry(2, 0.5); }
+            if (b == 1200) { cut->setPostFilterLp(1, 0.5); cut->setPostFilterHp(1, 0.5); }
+            for (int v = 0; v < numVoices; ++v) {
+                for (int i = 0; i < blockSize; ++i) {
+                    in[v][i] = 0.4f * std::sin(static_cast<float>(phase + i * (v + 1) * 0.013)) + noise(rng);
+                }
+            }
+            if (mode == Mode::Blocks) {
+                const float *ip[numVoices];
+                float *op[numVoices];
+                for (int v = 0; v < numVoices; ++v) {
+                    ip[v] = v < n ? in[v].data() : nullptr;
+                    op[v] = out[v].data();
+                }
+                cut->processBlocks(ip, op, blockSize);
+            } else {
+                for (int v = 0; v < n; ++v) {
+                    cut->processBlock(v, in[v].data(), out[v].data(), blockSize);
+                }
+            }
+            for (int v = 0; v < n; ++v) {
+                result.insert(result.end(), out[v].begin(), out[v].end());
+            }
+            phase += blockSize * 0.013;
+        }
+        for (int v = 0; v < n; ++v) {
+            result.insert(result.end(), buf[v], buf[v] + 48000 * 4);
+        }
+        delete cut;
+        return result;
+    }
+
+    bool check(const char *what, bool ok) {
+        printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    bool same(const char *what, const std::vector<float> &a, const std::vector<float> &b) {
+        return check(what, a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0);
+    }
+
+    // a leader and a follower, each recording into its own buffer from the same input.
+    // the follower's own rate, loop and fades differ, and are ignored. the leader cuts
+    // and changes rate, also while not recording, and while the follower is skipped.
+    // fills in the output and buffer of each voice.
+    void runFollow(Mode mode, std::vector<float> &lead, std::vector<float> &follow) {
+        auto *cut = new Softcut<2>();
+        std::fill(buf[0], buf[0] + bufFrames, 0.f);
+        std::fill(buf[1], buf[1] + bufFrames, 0.f);
+        cut->setSampleRate(48000);
+        for (int v = 0; v < 2; ++v) {
+            cut->setVoiceBuffer(v, buf[v], bufFrames);
+            cut->setRecLevel(v, 1.0); cut->setPreLevel(v, 0.5);
+            cut->setRecFlag(v, true); cut->setPlayFlag(v, true);
+        }
+        cut->setLoopStart(0, 0.1); cut->setLoopEnd(0, 0.6); cut->setLoopFlag(0, true);
+        cut->setRate(0, 1.3); cut->setRateSlewTime(0, 0.05); cut->setFadeTime(0, 0.02);
+        cut->setLoopStart(1, 2.0); cut->setLoopEnd(1, 3.0);
+        cut->setRate(1, -0.5); cut->setFadeTime(1, 0.1);
+        cut->cutToPos(0, 0.2); cut->cutToPos(1, 2.5);
+        cut->setFollow(1, 0);
+
+        std::mt19937 rng(77);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<float> in(blockSize);
+        std::vector<std::vector<float>> out(2, std::vector<float>(blockSize));
+        lead.clear();
+        follow.clear();
+        for (int b = 0; b < 1500; ++b) {
+            if (b % 37 == 20) { cut->cutToPos(0, 0.1f + 0.05f * ((b / 37) % 9)); }
+            if (b == 500) { cut->setRate(0, -0.8); }
+            if (b == 800) { cut->setRecFlag(0, false); cut->setRecFlag(1, false); }
+            if (b == 900) { cut->setRecFlag(0, true); cut->setRecFlag(1, true); }
+            for (float &x : in) {
+                x = noise(rng);
+            }
+            // (while the leader isn't recording, so that the buffers stay the same)
+            const bool skip = (b >= 820 && b < 880);
+            if (mode == Mode::Blocks) {
+                const float *ip[2] = { in.data(), skip ? nullptr : in.data() };
+                float *op[2] = { out[0].data(), out[1].data() };
+                cut->processBlocks(ip, op, blockSize);
+            } else {
+                cut->processBlock(0, in.data(), out[0].data(), blockSize);
+                if (!skip) {
+                    cut->processBlock(1, in.data(), out[1].data(), blockSize);
+                }
+            }
+            if (!skip) {
+                lead.insert(lead.end(), out[0].begin(), out[0].end());
+                follow.insert(follow.end(), out[1].begin(), out[1].end());
+            }
+        }
+        lead.insert(lead.end(), buf[0], buf[0] + 48000 * 4);
+        follow.insert(follow.end(), buf[1], buf[1] + 48000 * 4);
+        delete cut;
+    }
+
+    struct DuckResult {
+        // RMS level of the ducking voice, relative to the other
+        float level;
+        // whether the two were exactly the same
+        bool same;
+    };
+
+    // a voice recording, and two voices playing its buffer at the same position, one ducking.
+    // the players read at each of the given distances (in seconds) from the write head in turn.
+    std::vector<DuckResult> runDuck(const std::vector<float> &distances) {
+        auto *cut = new Softcut<3>();
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        // (so that there is something to read ahead of the write head, too)
+        std::generate(buf[0], buf[0] + bufFrames, [&] { return noise(rng); });
+        cut->setSampleRate(48000);
+        for (int v = 0; v < 3; ++v) {
+            cut->setVoiceBuffer(v, buf[0], bufFrames);
+            cut->setLoopStart(v, 0.0); cut->setLoopEnd(v, 2.0); cut->setLoopFlag(v, true);
+        }
+        cut->setRecLevel(0, 1.0); cut->setPreLevel(0, 0.5); cut->setRecFlag(0, true);
+        cut->setPlayFlag(1, true); cut->setPlayFlag(2, true);
+        cut->setDuck(1, 0);
+        cut->setDuckWindow(1, 0.05);
+        cut->cutToPos(0, 0.0);
+
+        std::vector<float> in(blockSize);
+        std::vector<std::vector<float>> out(3, std::vector<float>(blockSize));
+        const float *ip[3] = { in.data(), in.data(), in.data() };
+        float *op[3] = { out[0].data(), out[1].data(), out[2].data() };
+        std::vector<DuckResult> results;
+        for (size_t k = 0; k < distances.size(); ++k) {
+            cut->syncVoice(1, 0, distances[k]);
+            cut->syncVoice(2, 0, distances[k]);
+            double ducked = 0.0;
+            double plain = 0.0;
+            bool same = true;
+            for (int b = 0; b < 300; ++b) {
+                for (float &x : in) {
+                    x = noise(rng);
+                }
+                cut->processBlocks(ip, op, blockSize);
+                // (after the cut, and the duck level, have settled)
+                if (b < 50) {
+                    continue;
+                }
+                for (int i = 0; i < blockSize; ++i) {
+                    ducked += out[1][i] * out[1][i];
+                    plain += out[2][i] * out[2][i];
+                    same &= (out[1][i] == out[2][i]);
+                }
+            }
+            results.push_back({static_cast<float>(std::sqrt(ducked / plain)), same});
+        }
+        delete cut;
+        return results;
+    }
+
+    // play the buffer at the given rate from 0.5s, with no fades or slew.
+    // fills in the output, and the same reads computed frame by frame from the buffer
+    // (where the reads should be exact: from the second block, after the cut)
+    // at positions taken as a product, rather than a sum over frames.
+    // returns the position after the last block, in seconds.
+    phase_t runRead(InterpQuality q, float rate, int numBlocks,
+                    std::vector<float> &out, std::vector<float> &expected) {
+        auto *cut = new Softcut<1>();
+        std::mt19937 rng(11);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        std::generate(buf[0], buf[0] + bufFrames, [&] { return noise(rng); });
+        cut->setSampleRate(48000);
+        cut->setVoiceBuffer(0, buf[0], bufFrames);
+        cut->setLoopStart(0, 0.0); cut->setLoopEnd(0, 10.0); cut->setLoopFlag(0, true);
+        cut->setFadeTime(0, 0.f); cut->setRateSlewTime(0, 0.f);
+        cut->setInterpolation(0, static_cast<int>(q));
+        cut->setRate(0, rate); cut->setPlayFlag(0, true); cut->cutToPos(0, 0.5);
+        cut->setPhaseQuant(0, 0);
+
+        std::vector<float> in(blockSize, 0.f);
+        std::vector<float> block(blockSize);
+        const float *ip[1] = { in.data() };
+        float *op[1] = { block.data() };
+        out.clear();
+        expected.clear();
+        for (int b = 0; b < numBlocks; ++b) {
+            cut->processBlocks(ip, op, blockSize);
+            for (int i = 0; i < blockSize; ++i) {
+                const headphase_t pos = Phase::fromIndex(24000)
+                                        + static_cast<headphase_t>(b * blockSize + i) * Phase::fromFrames(rate);
+                const float x = Phase::fraction(pos);
+                const float *y = buf[0] + Phase::index(pos);
+                float e;
+                switch (q) {
+                    case InterpQuality::Linear: e = InterpLinear::interpolate(x, y); break;
+                    case InterpQuality::Hermite: e = Interpolate::hermite<float>(x, y[-1], y[0], y[1], y[2]); break;
+                    default: e = InterpSinc::interpolate(x, y + 1 - InterpSinc::Taps / 2); break;
+                }
+                if (b > 0) {
+                    out.push_back(block[i]);
+                    expected.push_back(x == 0.f ? y[0] : e);
+                }
+            }
+        }
+        const phase_t end = cut->getQuantPhase(0);
+        delete cut;
+        return end;
+    }
+
+    // one voice reading a buffer at rate 1.5, then at rate 3, which reads from mip level 1.
+    // returns the output from the block before the switch to the one after it,
+    // and the same blocks computed here from the buffer and the level.
+    // (false if the levels weren't computed in time)
+    bool runLevelSwitch(std::vector<float> &out, std::vector<float> &expected) {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        std::generate(buf[0], buf[0] + bufFrames, [&] { return noise(rng); });
+        MipmapWorker mips(2);
+        auto *voice = new Voice();
+        voice->setBuffer(buf[0], bufFrames);
+        voice->setMipmap(&mips);
+        // (a second hold on the same mipmap, to see when its levels are ready)
+        Mipmap *mip = mips.attach(buf[0], bufFrames);
+        for (int wait = 0; mip->levelForRate(3.0) != 1; ++wait) {
+            if (wait == 5000) {
+                mip->release();
+                voice->setMipmap(nullptr);
+                delete voice;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        voice->setLoopStart(0.0); voice->setLoopEnd(8.0); voice->setLoopFlag(true);
+        voice->setFadeTime(0.f); voice->setRateSlewTime(0.f);
+        voice->setRate(1.5f); voice->setPlayFlag(true); voice->cutToPos(0.5);
+
+        std::vector<float> in(blockSize, 0.f);
+        std::vector<float> block(blockSize);
+        const int switchBlock = 10;
+        out.clear();
+        expected.clear();
+        for (int b = 0; b <= switchBlock + 1; ++b) {
+            if (b == switchBlock) {
+                voice->setRate(3.f);
+            }
+            voice->processBlockMono(in.data(), block.data(), blockSize);
+            if (b < switchBlock - 1) {
+                continue;
+            }
+            out.insert(out.end(), block.begin(), block.end());
+            for (int i = 0; i < blockSize; ++i) {
+                // (positions are exact in binary)
+                const double pos = (b < switchBlock)
+                                   ? 24000.0 + (b * blockSize + i) * 1.5
+                                   : 24000.0 + switchBlock * blockSize * 1.5 + ((b - switchBlock) * blockSize + i) * 3.0;
+                const int k0 = static_cast<int>(std::floor(pos));
+                const float *y0 = buf[0] + k0;
+                const float old = Interpolate::hermite<float>(static_cast<float>(pos - k0), y0[-1], y0[0], y0[1], y0[2]);
+                const int k1 = static_cast<int>(std::floor(pos * 0.5));
+                const float *y1 = mip->getLevel(1) + k1;
+                const float level = Interpolate::hermite<float>(static_cast<float>(pos * 0.5 - k1), y1[-1], y1[0], y1[1], y1[2]);
+                if (b < switchBlock) {
+                    expected.push_back(old);
+                } else if (b == switchBlock) {
+                    const float x = static_cast<float>(i + 1) * (1.f / static_cast<float>(blockSize));
+                    expected.push_back(old + (level - old) * x);
+                } else {
+                    expected.push_back(level);
+                }
+            }
+        }
+        mip->release();
+        voice->setMipmap(nullptr);
+        delete voice;
+        return true;
+    }
+
+    // play a short loop at the given rate, with fades.
+    // returns the position after the given number of blocks, in seconds.
+    phase_t runLoopPhase(float rate, int numBlocks) {
+        auto *cut = new Softcut<1>();
+        std::fill(buf[0], buf[0] + bufFrames, 0.f);
+        cut->setSampleRate(48000);
+        cut->setVoiceBuffer(0, buf[0], bufFrames);
+        cut->setLoopStart(0, 0.1234567f); cut->setLoopEnd(0, 0.3456789f); cut->setLoopFlag(0, true);
+        cut->setFadeTime(0, 0.005f);
+        cut->setRate(0, rate); cut->setPlayFlag(0, true); cut->cutToPos(0, 0.2f);
+        cut->setPhaseQuant(0, 0);
+        std::vector<float> in(blockSize, 0.f);
+        std::vector<float> out(blockSize);
+        const float *ip[1] = { in.data() };
+        float *op[1] = { out.data() };
+        for (int b = 0; b < numBlocks; ++b) {
+            cut->processBlocks(ip, op, blockSize);
+        }
+        const phase_t end = cut->getQuantPhase(0);
+        delete cut;
+        return end;
+    }
+
+    bool inRange(const char *what, float x, float lo, float hi) {
+        const bool ok = check(what, x >= lo && x <= hi);
+        if (!ok) {
+            printf("  %g, not in [%g, %g]\n", x, lo, hi);
+        }
+        return ok;
+    }
+
+    std::vector<float> runFilters(bool bank) {
+        static constexpr int numFilters = 6;
+        static constexpr int numSamples = 4096;
+        Svf svf[numFilters];
+        const float dry = 0.25f;
+        for (int k = 0; k < numFilters; ++k) {
+            svf[k].setSampleRate(48000);
+            svf[k].setRq(0.1f + 0.5f * k);
+            svf[k].setFc(100.f * (k + 1) * (k + 1));
+            svf[k].setLpMix(0.5f);
+            svf[k].setHpMix(k & 1 ? 0.3f : 0.f);
+            svf[k].setBpMix(k & 2 ? 0.2f : 0.f);
+            svf[k].setBrMix(0.1f);
+        }
+        std::mt19937 rng(99);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        std::vector<float> x(numFilters * numSamples);
+        for (float &s : x) {
+            s = noise(rng);
+        }
+        std::vector<float> y(numFilters * numSamples);
+        if (bank) {
+            SvfBank b(numFilters);
+            for (int k = 0; k < numFilters; ++k) {
+                b.load(k, svf[k], dry);
+            }
+            for (int i = 0; i < numSamples; ++i) {
+                for (int g = 0; g < b.numGroups(); ++g) {
+                    lanes_t in = {};
+                    for (int l = 0; l < LaneWidth && g * LaneWidth + l < numFilters; ++l) {
+                        in[l] = x[(g * LaneWidth + l) * numSamples + i];
+                    }
+                    const lanes_t out = b.process<false, Svf::Output::Mix>(g, in);
+                    for (int l = 0; l < LaneWidth && g * LaneWidth + l < numFilters; ++l) {
+                        y[(g * LaneWidth + l) * numSamples + i] = out[l];
+                    }
+                }
+            }
+        } else {
+            for (int k = 0; k < numFilters; ++k) {
+                for (int i = 0; i < numSamples; ++i) {
+                    const float s = x[k * numSamples + i];
+                    y[k * numSamples + i] = svf[k].getNextSample(s) + s * dry;
+                }
+            }
+        }
+        return y;
+    }
+}
+
+int main() {
+    bool ok = true;
+    static_assert(VoiceLanes::MaxSoloVoices >= 4, "per-voice comparison needs 4 solo voices");
+    ok &= same("4 voices: processBlock / processBlocks",
+               runScenario(4, Mode::PerVoice, 1), runScenario(4, Mode::Blocks, 1));
+    const std::vector<float> serial = runScenario(numVoices, Mode::Blocks, 1);
+    ok &= same("6 voices: processBlocks, run twice", serial, runScenario(numVoices, Mode::Blocks, 1));
+    ok &= same("6 voices: processBlocks, 1 / 2 threads", serial, runScenario(numVoices, Mode::Blocks, 2));
+    ok &= same("6 voices: processBlocks, 1 / 3 threads", serial, runScenario(numVoices, Mode::Blocks, 3));
+    ok &= same("6 filters: Svf / SvfBank", runFilters(false), runFilters(true));
+    std::vector<float> lead, follow;
+    runFollow(Mode::Blocks, lead, follow);
+    ok &= same("follow: leader / follower, processBlocks", lead, follow);
+    runFollow(Mode::PerVoice, lead, follow);
+    ok &= same("follow: leader / follower, processBlock", lead, follow);
+    // (with a 0.05s window, and an equal-power curve: 0.95 at 0.04s, 0.59 at 0.02s)
+    const std::vector<DuckResult> duck = runDuck({0.5f, 0.04f, 0.02f, -0.02f, 0.f, 0.3f});
+    ok &= check("duck: 0.5s from the write head, unchanged", duck[0].same);
+    ok &= inRange("duck: 0.04s from the write head", duck[1].level, 0.9f, 0.99f);
+    ok &= inRange("duck: 0.02s ahead of the write head", duck[2].level, 0.5f, 0.7f);
+    ok &= inRange("duck: 0.02s behind the write head", duck[3].level, 0.5f, 0.7f);
+    ok &= inRange("duck: at the write head", duck[4].level, 0.f, 0.05f);
+    ok &= check("duck: 0.3s from the write head, unchanged", duck[5].same);
+    ok &= same("6 voices: no mip levels / levels on, then off",
+               serial, runScenario(numVoices, Mode::Blocks, 1, true));
+    std::vector<float> read, expected;
+    const char *tiers[] = { "linear", "hermite", "sinc" };
+    for (int q = 0; q < 3; ++q) {
+        char what[64];
+        // (rates here are exact in binary, so positions are too)
+        runRead(static_cast<InterpQuality>(q), 2.f, 200, read, expected);
+        snprintf(what, sizeof(what), "read: %s, on frames", tiers[q]);
+        ok &= same(what, read, expected);
+        runRead(static_cast<InterpQuality>(q), -0.75f, 200, read, expected);
+        snprintf(what, sizeof(what), "read: %s, between frames", tiers[q]);
+        ok &= same(what, read, expected);
+    }
+#if SOFTCUT_FIXED_PHASE
+    // (1.1f is 4724464128 in 32.32, so 8s from frame 24000 ends here, exactly)
+    const phase_t end = runRead(InterpQuality::Hermite, 1.1f, 6000, read, expected);
+    ok &= check("fixed phase: position after 8s at rate 1.1",
+                end == Phase::toFrames(headphase_t(1917273440256000)) / 48000.0);
+    ok &= same("fixed phase: reads over 8s at rate 1.1", read, expected);
+#endif
+    // (stored from a run; builds with and without fixed-point positions both end here)
+    ok &= check("loop: position after 8s of passes at rate 1.1", runLoopPhase(1.1f, 6000) == 0.33328171027700104);
+    ok &= check("loop: position after 8s of passes at rate -0.7", runLoopPhase(-0.7f, 6000) == 0.1561101676163574);
+    const bool built = runLevelSwitch(read, expected);
+    ok &= check("mips: levels computed", built);
+    if (built) {
+        ok &= same("mips: level switch, crossfaded over the block", read, expected);
+    }
+    return ok ? 0 : 1;
+}
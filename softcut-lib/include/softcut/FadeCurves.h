@@ -1,14 +1,21 @@
 //
 // Created by ezra on 11/15/18.
 //
-// static class for producing curves in fade period
-//
-// FIXME: this should be an object owned by SoftcutHead, passed to child SubHeads
+// class for producing curves in fade period.
+// a single set of curves is shared by all voices, through FadeCurveRegistry.
 
 
 #ifndef Softcut_FADECURVES_H
 #define Softcut_FADECURVES_H
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Interpolate.h"
+
 namespace softcut {
 
     class FadeCurves {
@@ -25,13 +32,24 @@ namespace softcut {
          void setPreShape(Shape x);
          void setRecShape(Shape x);
         // x is assumed to be in [0,1]
-         float getRecFadeValue(float x);
+        // (defined inline, since these are looked up per frame when writing)
+         float getRecFadeValue(float x) const {
+             return Interpolate::tabLinear<float, fadeBufSize>(recFadeBuf, x);
+         }
+
+         float getPreFadeValue(float x) const {
+             return Interpolate::tabLinear<float, fadeBufSize>(preFadeBuf, x);
+         }
 
-         float getPreFadeValue(float x);
+        // equal-power crossfade gain, sin(x * pi/2)
+         float getXfadeValue(float x) const {
+             return Interpolate::tabLinear<float, fadeBufSize>(xfadeBuf, x);
+         }
 
     private:
          void calcPreFade();
          void calcRecFade();
+         void calcXfade();
 
     private:
 
@@ -46,9 +64,68 @@ namespace softcut {
          unsigned int preWindowMinFrames;
          float recFadeBuf[fadeBufSize];
          float preFadeBuf[fadeBufSize];
+         float xfadeBuf[fadeBufSize];
          Shape recShape;
          Shape preShape;
     };
+
+    // holds the curve set shared by all voices.
+    // a published set is never modified; changes build a new set
+    // (off the audio thread) and swap it in atomically.
+    // readers (voices) take the current set at the start of each block and hold it
+    // until the end (see beginRead()). the current set and the one before it are kept;
+    // older sets are freed once no reader began its block before they were replaced.
+    class FadeCurveRegistry {
+    public:
+        static constexpr int MaxReaders = 64;
+
+        static FadeCurveRegistry &instance();
+
+        // safe to call from the audio thread
+        const FadeCurves *current() const {
+            return current_.load(std::memory_order_acquire);
+        }
+
+        // register a reader. returns its id, or -1 if all are taken
+        // (sets are then never freed while it exists)
+        int addReader();
+        void removeReader(int reader);
+        // the current set, held until endRead(). safe to call from the audio thread.
+        // calling again before endRead() moves to the newest set
+        const FadeCurves *beginRead(int reader);
+        void endRead(int reader);
+
+        // copy the current set, modify it, and publish the copy.
+        // may wait for readers to finish a block
+        void update(const std::function<void(FadeCurves &)> &change);
+
+        void setRecDelayRatio(float x);
+        void setPreWindowRatio(float x);
+        void setMinRecDelayFrames(unsigned int x);
+        void setMinPreWindowFrames(unsigned int x);
+        void setPreShape(FadeCurves::Shape x);
+        void setRecShape(FadeCurves::Shape x);
+
+    private:
+        FadeCurveRegistry();
+
+        // a published set, and the epoch it was published at
+        struct Set {
+            std::unique_ptr<FadeCurves> curves;
+            unsigned int epoch;
+        };
+
+        std::mutex mutex_;
+        // oldest first; the last is current
+        std::vector<Set> sets_;
+        std::atomic<const FadeCurves *> current_;
+        // sets published so far
+        std::atomic<unsigned int> epoch_;
+        // epoch at which each reader began its block, or Idle
+        std::atomic<unsigned int> readers_[MaxReaders];
+        bool readerUsed_[MaxReaders];
+        int untracked_;
+    };
 }
 
 #endif //Softcut_FADECURVES_H
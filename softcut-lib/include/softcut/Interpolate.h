@@ -5,20 +5,27 @@
 #ifndef Softcut_INTERPOLATE_H
 #define Softcut_INTERPOLATE_H
 
+#include <algorithm>
+
+#include "Lanes.h"
+
 namespace softcut {
     class Interpolate {
     public:
+        // NB: constants are float, so that T=float stays in single precision
+        // (they are exact, so results for T=double are unaffected).
+        // T may also be a vector type (see Lanes.h).
         template<typename T>
         static inline T hermite(T x, T y0, T y1, T y2, T y3) {
             // 4-point, 3rd-order Hermite (x-form)
 #if 0
             T c0 = y1;
-            T c1 = 0.5 * (y2 - y0);
-            T c2 = y0 - 2.5 * y1 + 2. * y2 - 0.5 * y3;
-            T c3 = 0.5 * (y3 - y0) + 1.5 * (y1 - y2);
+            T c1 = 0.5f * (y2 - y0);
+            T c2 = y0 - 2.5f * y1 + 2.f * y2 - 0.5f * y3;
+            T c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
             return ((c3 * x + c2) * x + c1) * x + c0;
 #else // inlined:
-            return (((0.5 * (y3 - y0) + 1.5 * (y1 - y2)) * x + (y0 - 2.5 * y1 + 2. * y2 - 0.5 * y3)) * x + 0.5 * (y2 - y0)) * x + y1;
+            return (((0.5f * (y3 - y0) + 1.5f * (y1 - y2)) * x + (y0 - 2.5f * y1 + 2.f * y2 - 0.5f * y3)) * x + 0.5f * (y2 - y0)) * x + y1;
 #endif
         }
 
@@ -27,7 +34,7 @@ namespace softcut {
         // - allocated table size is >= N+1
         // - index is in [0, 1]
         template<typename T, int N>
-        static inline T tabLinear(T* buf, float x) {
+        static inline T tabLinear(const T* buf, float x) {
             // FIXME: tidy/speed
             const float fi = x * (N-2);
             auto i = static_cast<unsigned int>(fi);
@@ -38,6 +45,78 @@ namespace softcut {
         }
 
     };
+
+    //-- interpolation quality tiers.
+    //-- each policy interpolates between taps y[Taps/2 - 1] and y[Taps/2],
+    //-- with x in [0, 1], from Taps consecutive frames in y.
+    //-- interpolate() works on float, and on lanes_t (one interpolation per lane).
+
+    enum class InterpQuality { Linear, Hermite, Sinc };
+
+    struct InterpLinear {
+        static constexpr int Taps = 2;
+        template<typename T>
+        static inline T interpolate(T x, const T *y) {
+            return y[0] + x * (y[1] - y[0]);
+        }
+    };
+
+    struct InterpHermite {
+        static constexpr int Taps = 4;
+        template<typename T>
+        static inline T interpolate(T x, const T *y) {
+            return Interpolate::hermite<T>(x, y[0], y[1], y[2], y[3]);
+        }
+    };
+
+    // windowed sinc, from a polyphase table
+    struct InterpSinc {
+        static constexpr int Taps = 8;
+        // table resolution, in phases per frame
+        static constexpr int Phases = 256;
+        // coefficients for each phase in [0, Phases] (inclusive), Taps per phase.
+        // filled in on startup (see Interpolate.cpp)
+        static float table[(Phases + 1) * Taps];
+
+        static inline float interpolate(float x, const float *y) {
+            const float fi = x * Phases;
+            // x may round up to exactly 1
+            const unsigned int i = std::min(static_cast<unsigned int>(fi), Phases - 1u);
+            const float c = fi - static_cast<float>(i);
+            const float *h0 = table + i * Taps;
+            const float *h1 = h0 + Taps;
+            float a = 0.f;
+            float b = 0.f;
+            for (int k = 0; k < Taps; ++k) {
+                a += h0[k] * y[k];
+                b += h1[k] * y[k];
+            }
+            return a + c * (b - a);
+        }
+
+        static inline lanes_t interpolate(lanes_t x, const lanes_t *y) {
+            const lanes_t fi = x * static_cast<float>(Phases);
+            lanes_t c = {};
+            lanes_t h0[Taps] = {};
+            lanes_t h1[Taps] = {};
+            for (int l = 0; l < LaneWidth; ++l) {
+                const unsigned int i = std::min(static_cast<unsigned int>(fi[l]), Phases - 1u);
+                c[l] = fi[l] - static_cast<float>(i);
+                const float *t = table + i * Taps;
+                for (int k = 0; k < Taps; ++k) {
+                    h0[k][l] = t[k];
+                    h1[k][l] = t[k + Taps];
+                }
+            }
+            lanes_t a = {};
+            lanes_t b = {};
+            for (int k = 0; k < Taps; ++k) {
+                a += h0[k] * y[k];
+                b += h1[k] * y[k];
+            }
+            return a + c * (b - a);
+        }
+    };
 }
 
 #endif //Softcut_INTERPOLATE_H
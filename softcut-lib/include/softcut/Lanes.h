@@ -0,0 +1,25 @@
+//
+// portable SIMD lanes, using compiler vector extensions (gcc / clang).
+// these compile to AVX, SSE or NEON instructions, depending on target flags.
+//
+
+#ifndef Softcut_LANES_H
+#define Softcut_LANES_H
+
+namespace softcut {
+
+#if defined(__AVX__)
+    static constexpr int LaneWidth = 8;
+#elif defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+    static constexpr int LaneWidth = 4;
+#else
+    static constexpr int LaneWidth = 1;
+#endif
+
+    // one float per lane; arithmetic operators work lane-wise,
+    // and scalar operands are broadcast to all lanes.
+    typedef float lanes_t __attribute__((vector_size(LaneWidth * sizeof(float))));
+
+}
+
+#endif //Softcut_LANES_H
@@ -0,0 +1,130 @@
+//
+// decimated copies of audio buffers, one per octave, for reading at high rates.
+//
+// reading every Nth frame of a buffer aliases, and touches a new cache line on each frame.
+// above a rate of 2, heads read instead from a copy lowpassed and decimated by 2 (per octave),
+// at a rate of 1 to 2 frames per frame.
+//
+// levels are computed on a background thread. write heads flag the regions they write,
+// and the thread refreshes those regions, shortly after writing moves on from them.
+// other changes can be flagged with MipmapWorker::markChanged(), and a slow
+// rolling sweep eventually picks up anything else.
+//
+// each voice reading a buffer holds its mipmap (see MipmapWorker::attach()).
+// when the last one releases it, the thread stops refreshing it and frees its levels,
+// and the slot can be claimed for another buffer.
+//
+
+#ifndef Softcut_MIPMAP_H
+#define Softcut_MIPMAP_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Types.h"
+
+namespace softcut {
+
+    class Mipmap {
+        friend class MipmapWorker;
+
+    public:
+        static constexpr int MaxLevels = 4;
+        // size of regions tracked for refreshing, as a power of 2 (in frames of the buffer)
+        static constexpr int ChunkShift = 12;
+
+        // true once changes to the buffer are being tracked; until then, marking is unnecessary
+        bool isTracking() const { return state.load(std::memory_order_acquire) >= Tracking; }
+
+        // give up a hold taken with MipmapWorker::attach(). safe from any thread.
+        // the buffer must not be freed before its last hold is released.
+        void release();
+
+        // flag a region (by chunk index) as written. safe from any thread.
+        // call after the writes, so that the refresh sees them.
+        void markDirty(unsigned int chunk) {
+            dirty[chunk >> 5].fetch_or(1u << (chunk & 31), std::memory_order_release);
+        }
+
+        // level to read at the given rate: 0 (the buffer itself) up to a rate of 2,
+        // then one level more per octave, up to the number of levels.
+        // the current level is kept while the rate stays within a semitone of its range,
+        // so that a rate held near a boundary doesn't switch back and forth.
+        // always 0 until levels have been computed.
+        //! @param current: level read from until now
+        int levelForRate(rate_t rate, int current = 0) const;
+
+        //! @param level: in [1, number of levels]
+        //! @return decimated buffer, with (buffer frames >> level) frames
+        const sample_t *getLevel(int level) const { return levels[level - 1].data(); }
+
+    private:
+        // (Released comes before Tracking, so released mipmaps aren't marked)
+        enum { Free, Released, Claimed, Tracking, Ready };
+        std::atomic<int> state{Free};
+        std::atomic<const sample_t *> source{nullptr};
+        // holds taken with attach()
+        std::atomic<int> users{0};
+        unsigned int frames = 0;
+        int numLevels = 0;
+        std::vector<sample_t> levels[MaxLevels];
+        // one bit per chunk
+        std::unique_ptr<std::atomic<uint32_t>[]> dirty;
+        unsigned int numChunks = 0;
+        //-- worker thread only:
+        // chunks flagged, but not yet refreshed
+        std::unique_ptr<uint32_t[]> pending;
+        // passes since pending chunks were last all refreshed
+        int deferredPasses = 0;
+        // next chunk for the rolling sweep
+        unsigned int sweepChunk = 0;
+        // release seen on an earlier pass
+        bool releaseSeen = false;
+    };
+
+    class MipmapWorker {
+    public:
+        static constexpr int MaxBuffers = 8;
+
+        //! @param numLevels: octaves below the buffer to keep (at most Mipmap::MaxLevels).
+        //! memory used is up to (1 - 2^-numLevels) times the size of each buffer.
+        explicit MipmapWorker(int numLevels);
+        ~MipmapWorker();
+        MipmapWorker(const MipmapWorker &) = delete;
+        MipmapWorker &operator=(const MipmapWorker &) = delete;
+
+        // find or claim the mipmap for a buffer, and take a hold on it (see Mipmap::release()).
+        // doesn't allocate or block, so it is safe on the audio thread;
+        // levels are computed later, on the worker thread.
+        //! @param frames: buffer size, a power of 2
+        //! @return null if all mipmaps are in use
+        Mipmap *attach(const sample_t *buf, unsigned int frames);
+
+        // true while the thread may still read the buffer; it stops after the last hold
+        // is released, and after any pass over the buffer it had started.
+        bool isHeld(const sample_t *buf) const;
+
+        // flag all of a buffer's mipmap for refreshing. safe from any thread.
+        void markChanged(const sample_t *buf);
+
+    private:
+        void run();
+        // allocate levels and compute them in full
+        void build(Mipmap &m);
+        // recompute all levels for one chunk of the buffer
+        void refresh(Mipmap &m, unsigned int chunk);
+        // free levels of a released mipmap, and make the slot free
+        void clear(Mipmap &m);
+
+        std::array<Mipmap, MaxBuffers> mips;
+        const int numLevels;
+        std::atomic<bool> quit;
+        std::thread thread;
+    };
+}
+
+#endif //Softcut_MIPMAP_H
@@ -0,0 +1,78 @@
+//
+// representation of head positions, in frames.
+//
+// by default, positions are doubles. built with SOFTCUT_FIXED_PHASE, they are 32.32 fixed point:
+// accumulating a rate is then exact (the rate itself is rounded to 2^-32 frames),
+// the frame index is the high word, and results are the same on every platform.
+// positions outside the heads (loop points in seconds, duck distances, etc) stay as phase_t.
+//
+
+#ifndef Softcut_PHASE_H
+#define Softcut_PHASE_H
+
+#include <cmath>
+#include <cstdint>
+
+#include "Types.h"
+
+namespace softcut {
+
+#if SOFTCUT_FIXED_PHASE
+
+    typedef int64_t headphase_t;
+
+    struct Phase {
+        static constexpr int FracBits = 32;
+        static constexpr headphase_t OneFrame = headphase_t(1) << FracBits;
+
+        static inline headphase_t fromFrames(phase_t x) {
+            return static_cast<headphase_t>(std::llround(x * static_cast<phase_t>(OneFrame)));
+        }
+        static inline headphase_t fromIndex(int i) {
+            return static_cast<headphase_t>(i) * OneFrame;
+        }
+        static inline phase_t toFrames(headphase_t p) {
+            return static_cast<phase_t>(p) * (1.0 / static_cast<phase_t>(OneFrame));
+        }
+        // frame at or before the position
+        static inline int index(headphase_t p) {
+            return static_cast<int>(p >> FracBits);
+        }
+        // distance from index(p), in [0, 1)
+        static inline float fraction(headphase_t p) {
+            return static_cast<float>(static_cast<uint32_t>(p)) * (1.f / static_cast<float>(OneFrame));
+        }
+        static inline bool isWhole(headphase_t p) {
+            return static_cast<uint32_t>(p) == 0;
+        }
+        // the same position, in a buffer decimated by 2^level
+        static inline headphase_t downscale(headphase_t p, int level) {
+            return p >> level;
+        }
+    };
+
+#else
+
+    typedef phase_t headphase_t;
+
+    struct Phase {
+        static constexpr headphase_t OneFrame = 1.0;
+
+        static inline headphase_t fromFrames(phase_t x) { return x; }
+        static inline headphase_t fromIndex(int i) { return static_cast<headphase_t>(i); }
+        static inline phase_t toFrames(headphase_t p) { return p; }
+        static inline int index(headphase_t p) { return static_cast<int>(p); }
+        static inline float fraction(headphase_t p) {
+            return static_cast<float>(p - (float)index(p));
+        }
+        static inline bool isWhole(headphase_t p) { return p == std::floor(p); }
+        static inline headphase_t downscale(headphase_t p, int level) {
+            return p * (1.0 / static_cast<headphase_t>(1 << level));
+        }
+    };
+
+#endif
+
+}
+
+#endif //Softcut_PHASE_H
@@ -5,10 +5,14 @@
 #ifndef CUTFADEVOICE_CUTFADEVOICELOGIC_H
 #define CUTFADEVOICE_CUTFADEVOICELOGIC_H
 
+#include <array>
 #include <cstdint>
+
+#include "Interpolate.h"
+#include "Resampler.h"
 #include "SubHead.h"
 #include "Types.h"
-#include "TestBuffers.h"
+#include "Trace.h"
 #include "FadeCurves.h"
 
 namespace softcut {
@@ -16,15 +20,49 @@ namespace softcut {
     class ReadWriteHead {
     public:
 
-        void init(FadeCurves *fc);
-
-        // per-sample update functions
-        void processSample(sample_t in, sample_t *out);
-        void processSampleNoRead(sample_t in, sample_t *out);
-        void processSampleNoWrite(sample_t in, sample_t *out);
+        void init(const FadeCurves *fc);
+        // switch to another curve set; takes effect from the next block
+        void setFadeCurves(const FadeCurves *fc);
+
+        //-- block processing stages.
+        //-- each runs over the whole block; call them in this order.
+        // advance phases, fades and states of both subheads.
+        // if Write is unset, only what is needed for reading is stored.
+        template<bool Write>
+        void updatePositions(const float *rateBuf, int numFrames);
+        // take positions, fades and states from another head, in place of updatePositions().
+        //! @param moved: whether the leader ran updatePositions<true>() for these frames;
+        //! if not, its current (unchanging) state is held for the block.
+        void followPositions(const ReadWriteHead &lead, int numFrames, bool moved);
+        // per-frame write position, taken from the louder subhead.
+        // call after updatePositions(), with the same rates.
+        void getWritePositions(const float *rateBuf, phase_t *pos, int numFrames);
+        //! per-frame level for ducking, falling to zero as the read position nears a reference position
+        //! (equal-power in distance, using the louder subhead). call after updatePositions().
+        //! @param ref: reference positions, e.g. another head's write positions
+        //! @param window: distance in frames at which ducking begins
+        void calcDuck(const phase_t *ref, float window, float *level, int numFrames);
+        // compute write levels from pre/rec levels and subhead fades
+        void updateLevels(const float *pre, const float *rec, int numFrames);
+        // read from both subheads and crossfade to output
+        void peekBlock(sample_t *out, int numFrames);
+        // resample input once, and write it through both subheads
+        void pokeBlock(const sample_t *in, const float *rate, int numFrames);
+        // keep write position current without writing (replaces the two stages above)
+        void skipBlock(const sample_t *in, const float *rate, int numFrames);
+        // push per-frame subhead state to the trace ring.
+        // does nothing unless built with SOFTCUT_TRACE.
+        //! @param write: whether pokeBlock() wrote this block (with levels from updateLevels());
+        //! if not (not recording, or skipBlock()), pre=1 and rec=0 are recorded
+        void traceBlock(int numFrames, bool write);
 
         void setSampleRate(float sr);
         void setBuffer(sample_t *buf, uint32_t size);
+        // decimated copies of the buffer (or null): read from at rates above 2,
+        // and flagged where the buffer is written
+        void setMipmap(Mipmap *mip);
+        Mipmap *getMipmap() const { return head[0].mip_; }
+        // derived values are only recomputed when the rate actually changes
         void setRate(rate_t x);
 
 	// set loop (region) start point in seconds
@@ -37,10 +75,6 @@ namespace softcut {
         bool getRecOnceDone();
         bool getRecOnceActive();
 
-	// set amplitudes
-        void setRec(float x);
-        void setPre(float x);
-
 	// enqueue a position change with crossfade
         void cutToPos(float seconds);
 
@@ -50,6 +84,13 @@ namespace softcut {
 	void run();
 
         void setRecOffsetSamples(int d);
+        // interpolation for reading, and for resampling input to write;
+        // takes effect from the next block
+        void setInterpolation(InterpQuality q);
+
+        // true if both subheads are stopped and nothing is pending,
+        // so that processing a block would neither read nor write
+        bool isStopped();
 
         phase_t getActivePhase();
         rate_t getRate();
@@ -63,17 +104,33 @@ namespace softcut {
         void enqueueCrossfade(phase_t newPhase);
         void dequeueCrossfade();
         void takeAction(Action act);
+        // frames from i with constant rate, no queued cut to take, and no subhead event
+        int framesToEvent(const float *rateBuf, int i, int numFrames);
 
-        sample_t mixFade(sample_t x, sample_t y, float a, float b); // mix two inputs with phases
+        // mix two inputs with fade positions (equal power)
+        sample_t mixFade(sample_t x, sample_t y, float a, float b) {
+            return x * fadeCurves->getXfadeValue(a) + y * fadeCurves->getXfadeValue(b);
+        }
         void calcFadeInc();
+        // true if input can be written one frame per frame, without interpolation
+        bool isUnityWrite(const float *rate, int numFrames);
+        // peekBlock() and pokeBlock(), for each interpolation tier
+        template<class Interp>
+        void peekBlockInterp(sample_t *out, int numFrames);
+        // read from both subheads at one mipmap level (0 for the buffer itself)
+        template<class Interp>
+        void peekLevel(sample_t *out, int numFrames, int level);
+        template<class Interp>
+        void pokeBlockInterp(const sample_t *in, const float *rate, int numFrames);
 
     private:
         SubHead head[2];
+        const FadeCurves *fadeCurves;
 
         sample_t *buf;      // audio buffer (allocated elsewhere)
-        float sr;           // sample rate
-        phase_t start;      // start/end points
-        phase_t end;
+        float sr = 48000;   // sample rate
+        headphase_t start;      // start/end points
+        headphase_t end;
         phase_t queuedCrossfade;
         bool queuedCrossfadeFlag;
         float fadeTime;     // fade time in seconds
@@ -81,14 +138,31 @@ namespace softcut {
 
         int active;         // current active play head index (0 or 1)
         bool loopFlag;      // set to loop, unset for 1-shot
-        float pre;      // pre-record level
-        float rec;      // record level
         bool recOnceFlag; // set to record one full loop
         bool recOnceDone; // triggers done to tell voice to unset rec flag
         int recOnceHead; // keeps track of which subhead is writing
 
         rate_t rate;    // current rate
-        TestBuffers testBuf;
+        int readLevel;  // mipmap level read from in the last block
+        InterpQuality interp;
+        // while rate is moving, fade increment is only updated at this interval
+        static constexpr int fadeIncInterval = 16;
+#if SOFTCUT_TRACE
+        TraceRing trace;
+#endif
+
+        // per-block subhead output, before crossfade
+        std::array<sample_t, MaxBlockFrames> readBuf[2];
+        // output at the previous mipmap level, while changing level
+        std::array<sample_t, MaxBlockFrames> levelBuf;
+
+        //-- write path, shared by both subheads
+        Resampler resamp;
+        // rate last applied to the resampler
+        rate_t writeRate;
+        // resampled input, and output frames per input frame
+        std::array<sample_t, Resampler::OUT_BLOCK_FRAMES> resampOut;
+        std::array<int, MaxBlockFrames> resampCount;
     };
 }
 #endif //CUTFADEVOICE_CUTFADEVOICELOGIC_H
@@ -5,19 +5,20 @@
 #ifndef SoftcutHEAD_RESAMPLER_H
 #define SoftcutHEAD_RESAMPLER_H
 
-#include <iostream>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include <boost/assert.hpp>
 #include "Types.h"
 #include "Interpolate.h"
+#include "Lanes.h"
+#include "Phase.h"
 
 // ultra-simple resampling class
-// works on mono output buffer and processes one input sample at a time
-
-// uncomment to use linear interpolation. honestly can't hear a huge difference?
-// FIXME: should be template param i guess
-// #define RESAMPLER_INTERPOLATE_LINEAR
+// works on mono output buffer and processes a run of input frames at a time.
+// interpolation is a template parameter (see Interpolate.h);
+// output is delayed by Interp::Taps/2 - 1 input frames.
 
 namespace softcut {
 
@@ -26,149 +27,153 @@ namespace softcut {
     public:
 
         enum {
-            IN_BUF_FRAMES = 4, // limits interpolation order
-            IN_BUF_MASK = 3,
-            OUT_BUF_FRAMES = 64 // limits resampling ratio
+            IN_BUF_FRAMES = 8, // limits interpolation order
+            IN_BUF_MASK = 7,
+            OUT_BUF_FRAMES = 64, // limits resampling ratio
+            OUT_BLOCK_FRAMES = MaxBlockFrames // output frames per processBlock() call
         };
 
         // constructor
-        Resampler() : rate_(1.0), phi_(1.0), phase_(0.0)
-#ifdef RESAMPLER_INTERPOLATE_LINEAR
-#else
-                ,inBufIdx_(0)
-#endif
-        {}
-
-        int processFrame(sample_t x){
+        Resampler() : rate_(1.0), inc_(Phase::OneFrame), phi_(1.0), maxFrames_(2), phase_(0), inBuf_(), inBufIdx_(0) {}
+
+        // at unity rate with zero output phase, each input frame produces
+        // exactly one output frame, equal to an earlier input frame
+        bool isUnity() const {
+            return rate_ == 1.0 && phase_ == 0;
+        }
+
+        // equivalent to processBlock() on one frame, when isUnity().
+        template<class Interp>
+        sample_t processFrameUnity(sample_t x) {
+            static_assert(Interp::Taps <= IN_BUF_FRAMES, "too many taps for input history");
             pushInput(x);
-            if(rate_ > 1.0) {
-                return writeUp();
-            } else {
-                return writeDown();
+            // interpolating at the far end of the segment returns an earlier input
+            return inBuf_[(inBufIdx_ - (Interp::Taps / 2 - 1)) & IN_BUF_MASK];
+        }
+
+        //! resample a run of input frames.
+        //! output frames are appended to out (up to OUT_BLOCK_FRAMES),
+        //! and the number produced for each input frame is stored in count.
+        //! stops early if the output could overflow.
+        //! @param rate: per-frame rate (sign is ignored)
+        //! @param out: may be null, to only count output frames
+        //! @return number of input frames consumed
+        template<class Interp>
+        int processBlock(const sample_t *in, const float *rate, int numFrames,
+                         sample_t *out, int *count) {
+            constexpr int taps = Interp::Taps;
+            static_assert(taps <= IN_BUF_FRAMES, "too many taps for input history");
+            // first pass: output phases, and the taps for each output frame.
+            // output phase is accumulated over the run rather than wrapped on each frame,
+            // so that the only serial dependency is one addition per frame;
+            // output frames so far are then floor(acc).
+            sample_t y[taps];
+            for (int k = 0; k < taps; ++k) {
+                y[k] = inBuf_[(inBufIdx_ + 1 + IN_BUF_FRAMES - taps + k) & IN_BUF_MASK];
+            }
+            headphase_t acc = phase_;
+            int accFrames = 0;
+            int numOut = 0;
+            int i = 0;
+            for (; i < numFrames && numOut + OUT_BUF_FRAMES <= OUT_BLOCK_FRAMES; ++i) {
+                setRate(std::fabs(rate[i]));
+                for (int k = 0; k < taps - 1; ++k) {
+                    y[k] = y[k + 1];
+                }
+                y[taps - 1] = in[i];
+                // the distance to the first output frame boundary,
+                // normalized to the distance between input frames
+                const phase_t f0 = (1.0 - Phase::toFrames(acc - Phase::fromIndex(accFrames))) * phi_;
+                acc += inc_;
+                const int nf = Phase::index(acc) - accFrames;
+                accFrames += nf;
+                // when upsampling, output frames are 1/rate apart in this normalized space
+                const phase_t df = (rate_ > 1.0) ? phi_ : 0.0;
+                // fill as many frames as this rate could produce, so that the loop count
+                // doesn't vary from frame to frame; any past nf are overwritten next time
+                for (int j = 0; j < maxFrames_; ++j) {
+                    const int o = numOut + j;
+                    blockX_[o] = static_cast<float>(f0 + (j + 1) * df);
+                    for (int k = 0; k < taps; ++k) {
+                        blockY_[k][o] = y[k];
+                    }
+                }
+                count[i] = nf;
+                numOut += nf;
             }
+            phase_ = acc - Phase::fromIndex(accFrames);
+            // keep the full history, in case interpolation changes
+            for (int j = std::max(0, i - IN_BUF_FRAMES); j < i; ++j) {
+                pushInput(in[j]);
+            }
+
+            if (out == nullptr) {
+                return i;
+            }
+
+            // second pass: interpolation, in lanes
+            int o = 0;
+            for (; o + LaneWidth <= numOut; o += LaneWidth) {
+                lanes_t x;
+                lanes_t t[taps];
+                std::memcpy(&x, blockX_ + o, sizeof(lanes_t));
+                for (int k = 0; k < taps; ++k) {
+                    std::memcpy(&t[k], blockY_[k] + o, sizeof(lanes_t));
+                }
+                const lanes_t v = Interp::interpolate(x, t);
+                std::memcpy(out + o, &v, sizeof(lanes_t));
+            }
+            for (; o < numOut; ++o) {
+                float t[taps];
+                for (int k = 0; k < taps; ++k) {
+                    t[k] = blockY_[k][o];
+                }
+                out[o] = Interp::interpolate(blockX_[o], t);
+            }
+            return i;
         }
 
         void setRate(rate_t r) {
+            if (r == rate_) {
+                return;
+            }
             rate_ = r;
+            inc_ = Phase::fromFrames(r);
             phi_ = 1.0 / r;
+            maxFrames_ = static_cast<int>(r) + 1;
         }
         // void setBuffer(float *buf, int frames);
-        void setPhase(phase_t phase) { phase_ = phase; }
-        const sample_t* output(){
-            return static_cast<const sample_t*>(outBuf_);
-        }
+        void setPhase(phase_t phase) { phase_ = Phase::fromFrames(phase); }
 
         void reset() {
-
-#ifdef RESAMPLER_INTERPOLATE_LINEAR
-            x_ = 0.f;
-#else
             for (sample_t &i : inBuf_) { i = 0.f; }
-            for (sample_t &i : outBuf_) { i = 0.f; }
             inBufIdx_ = 0;
-#endif
         }
 
     private:
         rate_t rate_;
-        // phase increment
+        // rate, as an output phase increment
+        headphase_t inc_;
+        // distance between output frames, normalized to input frames
         phase_t phi_;
+        // most output frames per input frame at this rate
+        int maxFrames_;
         // last written phase
-        phase_t phase_;
-#ifdef RESAMPLER_INTERPOLATE_LINEAR
-        // current input value
-        sample_t x_;
-        // last input value
-        sample_t x_1_;
-#else
+        headphase_t phase_;
         // input ringbuffer
         sample_t inBuf_[IN_BUF_FRAMES];
         unsigned int inBufIdx_;
-#endif
-        // output buffer
-        sample_t outBuf_[OUT_BUF_FRAMES];
+        //-- processBlock() scratch:
+        // interpolation position and input taps for each output frame
+        float blockX_[OUT_BLOCK_FRAMES];
+        sample_t blockY_[IN_BUF_FRAMES][OUT_BLOCK_FRAMES];
 
     private:
         // push an input value
         void pushInput(sample_t x){
-#ifdef RESAMPLER_INTERPOLATE_LINEAR
-            x_1_ = x_;
-            x_ = x;
-#else
             inBufIdx_ = (inBufIdx_ + 1) & IN_BUF_MASK;
             inBuf_[inBufIdx_] = x;
-#endif
-        }
-
-        // interpolate the most recent input samples
-        // @param f in [0, 1]
-        sample_t interpolate(phase_t f){
-#ifdef RESAMPLER_INTERPOLATE_LINEAR
-            return x_1_ + (x_ - x_1_) * f;
-#else
-            unsigned int i0, i1, i2, i3;
-            i0 = (inBufIdx_ + 1) & IN_BUF_MASK;
-            i1 = (inBufIdx_ + 2) & IN_BUF_MASK;
-            i2 = (inBufIdx_ + 3) & IN_BUF_MASK;
-            i3 = inBufIdx_;
-            return static_cast<sample_t>(Interpolate::hermite<phase_t>(f, inBuf_[i0],
-                                                                       inBuf_[i1],
-                                                                       inBuf_[i2],
-                                                                       inBuf_[i3]));
-#endif
         }
-
-
-        // write, upsampling
-        // return frames written (>= 1)
-        // assumptions: input has been pushed. rate_ > 1.0
-        int writeUp(){
-            phase_t p = phase_ + rate_;
-            auto nf = static_cast<unsigned int>(p);
-            // we can assume that n >= 1 here
-            // we want to track fractional output phase for interpolation
-            // this is normalized to the distance between input frames
-            // so: the distance to the first output frame boundary:
-            phase_t f = 1.0 - phase_;
-            // normalized (divided by rate);
-            f = f * phi_;
-            // write the first output frame
-            unsigned int i=0;
-            outBuf_[i] = interpolate(f);
-            while(i < nf) {
-                // distance between output frames in this normalized space is 1/rate
-                f += phi_;
-                outBuf_[i] = interpolate(f);
-                i++;
-            }
-            // store the remainder of the updated, un-normalized output phase
-            phase_ = p - static_cast<phase_t>(nf);
-            return nf;
-        }
-
-
-        // write, downsampling
-        // return frames written (0 or 1)
-        // assumptions: input has been pushed. rate_ <= 1.0
-        int writeDown(){
-            // number of frames will be 1 or 0.
-            // as with upsampling inner loop,
-            // we need to produce a fractional interpolation coefficient,
-            // by "normalizing" to the output phase period
-            phase_t p = phase_ + rate_;
-            BOOST_ASSERT_MSG(p >= 0.0, "resampler encountered negative phase");
-            auto nf = static_cast<unsigned int>(p);
-            if (nf > 0) {
-                phase_t f = 1.0 - phase_;
-                f *= phi_;
-                outBuf_[0] = interpolate(f);
-                phase_ = p - static_cast<phase_t>(nf);
-            } else {
-                phase_ = p;
-            }
-            return nf;
-        }
-
     };
 
 }
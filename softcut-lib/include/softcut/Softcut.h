@@ -5,10 +5,14 @@
 #ifndef Softcut_Softcut_H
 #define Softcut_Softcut_H
 
+#include <algorithm>
 #include <memory>
 #include <thread>
+#include "Mipmap.h"
 #include "Types.h"
 #include "Voice.h"
+#include "VoiceLanes.h"
+#include "WorkerPool.h"
 
 namespace softcut {
     template<int numVoices>
@@ -23,14 +27,105 @@ namespace softcut {
         void reset() {
             for (int v = 0; v < numVoices; ++v) {
                 scv[v].reset();
+                followIdx[v] = -1;
+                duckIdx[v] = -1;
             };
         }
 
         // assumption: channel count is equal to voice count!
+        // NB: for follow and duck modes, leaders and references must be processed
+        // before the voices that depend on them, in blocks of no more than MaxBlockFrames.
         void processBlock(int v, const float *in, float *out, int numFrames) {
             scv[v].processBlockMono(in, out, numFrames);
         }
 
+        // process all voices together, with per-sample filter arithmetic
+        // running across voices in SIMD lanes (see SvfBank).
+        // voices with a null input pointer are skipped.
+        // NB: all voices read before any voice writes, so where voices share
+        // buffer regions, reads see other voices' writes one block later
+        // than with sequential processBlock() calls.
+        // with more than one thread (see setNumThreads()), voices whose buffer
+        // regions don't overlap are processed concurrently; voices that share
+        // a buffer, followers with their leaders, and ducking voices with their
+        // references always stay together on one thread, in the order above.
+        // each thread filters all of its voices together.
+        void processBlocks(const float *const *in, float *const *out, int numFrames) {
+            int n = 0;
+            for (int v = 0; v < numVoices; ++v) {
+                if (in[v] == nullptr) {
+                    continue;
+                }
+                if (scv[v].isIdle()) {
+                    scv[v].processIdle(out[v], numFrames);
+                } else {
+                    active[n++] = v;
+                }
+            }
+
+            blockIn = in;
+            blockOut = out;
+            blockFrames = numFrames;
+            blockFilterLanes = n > VoiceLanes::MaxSoloVoices;
+            const bool parallel = pool && numFrames >= parallelMinFrames;
+            const int numGroups = groupVoices(n, parallel ? pool->getNumWorkers() + 1 : 1);
+            if (parallel && numGroups > 1) {
+                pool->run(numGroups, &Softcut::runGroup, this);
+            } else {
+                for (int g = 0; g < numGroups; ++g) {
+                    processGroup(g);
+                }
+            }
+
+            for (int v = 0; v < numVoices; ++v) {
+                if (in[v] != nullptr) {
+                    scv[v].endBlock();
+                }
+            }
+        }
+
+        // number of threads used by processBlocks(), including the calling thread.
+        // 1 (the default) processes everything on the calling thread.
+        // limited to the number of cores, since spinning workers can't share one.
+        // must not be called while processBlocks() is running.
+        void setNumThreads(int n) {
+            const int cores = static_cast<int>(std::thread::hardware_concurrency());
+            n = std::max(1, std::min(n, numVoices));
+            if (cores > 0) {
+                n = std::min(n, cores);
+            }
+            if (n == 1) {
+                pool.reset();
+            } else {
+                pool.reset(new WorkerPool(n - 1));
+            }
+        }
+
+        // keep decimated copies of voice buffers, n octaves deep, for reading at rates above 2
+        // (see Mipmap.h). 0 (the default) keeps none.
+        // copies take up to as much memory again as the buffers.
+        // must not be called while processBlocks() is running.
+        void setMipLevels(int n) {
+            for (auto &v : scv) {
+                v.setMipmap(nullptr);
+            }
+            mips.reset();
+            if (n > 0) {
+                mips.reset(new MipmapWorker(n));
+                for (auto &v : scv) {
+                    v.setMipmap(mips.get());
+                }
+            }
+        }
+
+        // refresh mipmaps of a buffer whose contents were changed other than by voices
+        // (e.g. loaded from disk). can be called from non-audio threads.
+        void markBufferChanged(const float *buf) {
+            if (mips) {
+                mips->markChanged(buf);
+            }
+        }
+
         void setSampleRate(unsigned int hz) {
             for (auto &v : scv) {
                 v.setSampleRate(hz);
@@ -157,6 +252,11 @@ namespace softcut {
             scv[i].setRateSlewTime(d);
         }
 
+        // 0 = linear, 1 = hermite (default), 2 = windowed sinc
+        void setInterpolation(int i, int quality) {
+            scv[i].setInterpolation(static_cast<InterpQuality>(std::min(std::max(quality, 0), 2)));
+        }
+
         phase_t getQuantPhase(int i) {
             return scv[i].getQuantPhase();
         }
@@ -181,8 +281,75 @@ namespace softcut {
             scv[follow].cutToPos(scv[lead].getActivePosition() + offset);
         }
 
+        // hard-sync one voice's head to another's, every sample (see Voice::setFollow()).
+        // a negative lead index, or the voice's own, stops following.
+        // there are no chains: following a follower means following its leader,
+        // and followers of a voice that starts following move to its new leader.
+        void setFollow(int follow, int lead) {
+            int prev[numVoices];
+            std::copy(followIdx, followIdx + numVoices, prev);
+            if (lead >= 0 && followIdx[lead] == follow) {
+                // swap roles
+                followIdx[lead] = -1;
+            } else if (lead >= 0 && followIdx[lead] >= 0) {
+                lead = followIdx[lead];
+            }
+            if (lead == follow) {
+                lead = -1;
+            }
+            followIdx[follow] = lead;
+            if (lead >= 0) {
+                for (int v = 0; v < numVoices; ++v) {
+                    if (followIdx[v] == follow) {
+                        followIdx[v] = lead;
+                    }
+                }
+            }
+            for (int v = 0; v < numVoices; ++v) {
+                const int l = followIdx[v];
+                if (l != prev[v]) {
+                    scv[v].setFollow(l < 0 ? nullptr : &scv[l]);
+                }
+                bool leading = false;
+                for (int w = 0; w < numVoices; ++w) {
+                    leading |= (followIdx[w] == v);
+                }
+                scv[v].setLeading(leading);
+            }
+        }
+
+        // lower a voice's output while it reads near another voice's write position
+        // (see Voice::setDuck()). a negative ref index, or the voice's own, stops ducking.
+        void setDuck(int voice, int ref) {
+            if (ref == voice) {
+                ref = -1;
+            }
+            duckIdx[voice] = ref;
+            scv[voice].setDuck(ref < 0 ? nullptr : &scv[ref]);
+            for (int v = 0; v < numVoices; ++v) {
+                bool publish = false;
+                for (int w = 0; w < numVoices; ++w) {
+                    publish |= (duckIdx[w] == v);
+                }
+                scv[v].setDuckPublish(publish);
+            }
+        }
+
+        void setDuckWindow(int voice, float sec) {
+            scv[voice].setDuckWindow(sec);
+        }
+
+        // with mip levels on, a buffer no voice points at anymore is let go by the mipmap thread
+        // a little later; free the old buffer once isBufferHeld() is false
         void setVoiceBuffer(int id, float *buf, size_t bufFrames) {
             scv[id].setBuffer(buf, bufFrames);
+            scv[id].setMipmap(mips.get());
+        }
+
+        // true while the mipmap thread may still read the buffer (see setVoiceBuffer()).
+        // can be called from non-audio threads
+        bool isBufferHeld(const float *buf) const {
+            return mips && mips->isHeld(buf);
         }
 
 	// can be called from non-audio threads
@@ -195,8 +362,145 @@ namespace softcut {
 	    scv[i].stop();
 	}
 	
+    private:
+        // blocks shorter than this are processed on one thread,
+        // since handing them off would cost more than it saves
+        static constexpr int parallelMinFrames = 64;
+
+        // sort active voices into groups with overlapping buffer regions,
+        // and pack those into at most maxGroups groups.
+        // returns the number of groups
+        int groupVoices(int numActive, int maxGroups) {
+            int numGroups = 0;
+            for (int i = 0; i < numActive; ++i) {
+                const int v = active[i];
+                int g = -1;
+                for (int j = 0; j < i; ++j) {
+                    const int w = active[j];
+                    if (scv[v].sharesBuffer(scv[w]) || followIdx[v] == w || followIdx[w] == v
+                        || duckIdx[v] == w || duckIdx[w] == v) {
+                        if (g < 0) {
+                            g = group[j];
+                        } else if (group[j] != g) {
+                            // v joins two groups; merge them
+                            const int h = group[j];
+                            for (int k = 0; k < i; ++k) {
+                                if (group[k] == h) { group[k] = g; }
+                            }
+                        }
+                    }
+                }
+                group[i] = g < 0 ? numGroups++ : g;
+            }
+            // independent groups can share a thread, and filtering more voices
+            // together fills more SIMD lanes. so pack them: largest first, each
+            // into the emptiest of maxGroups bins.
+            int size[numVoices] = {};
+            for (int i = 0; i < numActive; ++i) {
+                ++size[group[i]];
+            }
+            int bin[numVoices];
+            int binSize[numVoices] = {};
+            int numBins = 0;
+            for (;;) {
+                int g = -1;
+                for (int h = 0; h < numGroups; ++h) {
+                    if (size[h] > 0 && (g < 0 || size[h] > size[g])) {
+                        g = h;
+                    }
+                }
+                if (g < 0) {
+                    break;
+                }
+                int b = 0;
+                if (numBins < maxGroups) {
+                    b = numBins++;
+                } else {
+                    for (int c = 1; c < numBins; ++c) {
+                        if (binSize[c] < binSize[b]) { b = c; }
+                    }
+                }
+                bin[g] = b;
+                binSize[b] += size[g];
+                size[g] = 0;
+            }
+            // collect members in voice order
+            for (int b = 0; b < numBins; ++b) {
+                int count = 0;
+                for (int i = 0; i < numActive; ++i) {
+                    if (bin[group[i]] == b) {
+                        groupVoice[b][count++] = active[i];
+                    }
+                }
+                groupSize[b] = count;
+            }
+            return numBins;
+        }
+
+        static void runGroup(void *self, int g) {
+            static_cast<Softcut *>(self)->processGroup(g);
+        }
+
+        void processGroup(int g) {
+            Voice *voices[numVoices];
+            const float *vin[numVoices];
+            float *vout[numVoices];
+            const int n = groupSize[g];
+            for (int i = 0; i < n; ++i) {
+                const int v = groupVoice[g][i];
+                voices[i] = &scv[v];
+                vin[i] = blockIn[v];
+                vout[i] = blockOut[v];
+            }
+
+            for (int offset = 0; offset < blockFrames; offset += MaxBlockFrames) {
+                const int frames = std::min(blockFrames - offset, static_cast<int>(MaxBlockFrames));
+                // leaders first, so that followers can take their head state
+                for (int i = 0; i < n; ++i) {
+                    if (!voices[i]->isFollower()) {
+                        voices[i]->readFrames(frames);
+                    }
+                }
+                for (int i = 0; i < n; ++i) {
+                    if (voices[i]->isFollower()) {
+                        voices[i]->readFrames(frames);
+                    }
+                }
+                for (int i = 0; i < n; ++i) {
+                    voices[i]->duckFrames(frames);
+                }
+                VoiceLanes::filterFrames(voices, vin, vout, n, frames, blockFilterLanes);
+                for (int i = 0; i < n; ++i) {
+                    voices[i]->writeFrames(frames);
+                    vin[i] += frames;
+                    vout[i] += frames;
+                }
+            }
+        }
+
     private:
         Voice scv[numVoices];
+
+        //-- processBlocks() state, shared with worker threads
+        const float *const *blockIn;
+        float *const *blockOut;
+        int blockFrames;
+        // filter in SIMD lanes, for all groups alike (so that grouping doesn't change results)
+        bool blockFilterLanes;
+        // indices of active voices, and their group numbers
+        int active[numVoices];
+        int group[numVoices];
+        // members of each group
+        int groupVoice[numVoices][numVoices];
+        int groupSize[numVoices];
+
+        // leader of each voice in follow mode, or -1
+        int followIdx[numVoices];
+        // reference of each voice in duck mode, or -1
+        int duckIdx[numVoices];
+
+        std::unique_ptr<WorkerPool> pool;
+        std::unique_ptr<MipmapWorker> mips;
     };
 }
 
@@ -9,10 +9,19 @@
 #ifndef Softcut_SUBHEAD_H
 #define Softcut_SUBHEAD_H
 
-#include "Resampler.h"
+#include <algorithm>
+#include <array>
+
+#include <boost/assert.hpp>
+
+#include "Interpolate.h"
+#include "Lanes.h"
+#include "Mipmap.h"
+#include "Phase.h"
 #include "SoftClip.h"
 #include "Types.h"
 #include "FadeCurves.h"
+#include "Trace.h"
 
 namespace softcut {
 
@@ -23,26 +32,78 @@ namespace softcut {
         friend class ReadWriteHead;
 
     public:
-        void init(FadeCurves *fc);
+        void init(const FadeCurves *fc);
         void setSampleRate(float sr);
 
     private:
-        sample_t peek4();
+        // true if phases in the block start on an integer frame
+        // and step by exactly one frame, with no cuts
+        bool isUnitySpan(int numFrames, int &dir) const;
         unsigned int wrapBufIndex(int x);
 
     protected:
-        static constexpr int blockSize = 2048;
-        sample_t peek();
-        //! poke
-        //! @param in: input value
+        // interpolated read at one phase, from a buffer of the given size (2^N)
+        template<class Interp>
+        sample_t peek(const sample_t *buf, unsigned int frames, headphase_t phase);
+        Action updatePhase(headphase_t start, headphase_t end, bool loop);
+        void updateFade(float inc);
+        //! frames from now for which updatePhase() and updateFade() can't produce an event
+        //! (crossing a loop point, or finishing a fade), at the current rate.
+        //! errs short, by a frame or so, to allow for rounding.
+        //! @param limit: largest result wanted
+        int framesToEvent(headphase_t start, headphase_t end, float fadeInc, int limit) const;
+
+        //-- block processing stages, driven by ReadWriteHead
+        // prepare per-block state buffers
+        void beginBlock();
+        // take phase, fade, state and write index from another subhead, with its per-frame buffers
+        // (or, if !moved, its current state held over the block)
+        void followFrames(const SubHead &lead, int numFrames, bool moved);
+        // store current phase and fade for the given frame,
+        // and if the block is writing, state and write flags
+        //! @param write: whether this subhead may write on this frame
+        template<bool Write>
+        void storeFrame(int i, bool write);
+        // storeFrame(), updatePhase() and updateFade() on each of n frames from i,
+        // without checks; only for frames where no event can happen (see framesToEvent())
+        template<bool Write>
+        void storeSpan(int i, int n, bool write, float fadeInc);
+        //! compute per-frame write levels from stored fades
         //! @param pre: scaling level for previous buffer content
         //! @param rec: scaling level for new content
-        void poke(sample_t in, float pre, float rec);
-        Action updatePhase(phase_t start, phase_t end, bool loop);
-        void updateFade(float inc);
+        void calcLevels(const float *pre, const float *rec, int numFrames);
+        //! read from the buffer at each stored phase
+        //! @param level: mipmap level to read from, or 0 for the buffer itself
+        template<class Interp>
+        void peekBlock(sample_t *out, int numFrames, int level);
+        // interpolated reads at each stored phase, from the buffer or a mipmap level of it
+        //! @param frames: size of buf (2^N)
+        template<class Interp>
+        void interpolateFrames(sample_t *out, int numFrames,
+                               const sample_t *buf, unsigned int frames, int level);
+        //-- writing, from resampled input shared by both subheads.
+        //-- a block is written with beginWrite(), then pokeFrames() or skipFrames()
+        //-- on consecutive runs of frames (or pokeFramesUnity() on all of them).
+        // start writing from the write index at the start of the block
+        void beginWrite();
+        //! write resampled input at each frame, using stored levels
+        //! @param src: resampler output for these frames
+        //! @param count: resampler output frames per frame
+        //! @param offset: first frame of the run in the block
+        void pokeFrames(const sample_t *src, const int *count, const float *rate, int offset, int numFrames);
+        //! as pokeFrames(), for a whole block at constant unity rate (one output per frame)
+        //! @param dir: write direction
+        void pokeFramesUnity(const sample_t *src, int dir, int numFrames);
+        //! advance the write index as pokeFrames() would, without touching the buffer
+        //! (for writes that would leave it unchanged)
+        void skipFrames(const int *count, const float *rate, int offset, int numFrames);
+        // flag regions written in this block as changed, for the mipmap
+        void endWrite();
+        // note a frame about to be (or just) written, for endWrite()
+        void markWrite(unsigned int idx);
 
         // getters
-        phase_t phase() { return phase_; }
+        phase_t phase() { return Phase::toFrames(phase_); }
         float fade() { return fade_; }
         float trig() { return trig_; }
         State state() { return state_; }
@@ -54,33 +115,189 @@ namespace softcut {
         // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
         // **NB** buffer size must be a power of two!!!!
         void setBuffer(sample_t *buf, unsigned int frames);
+        // decimated copies of the buffer, to read from at high rates and to flag writes to
+        void setMipmap(Mipmap *mip);
         void setRate(rate_t rate);
-        FadeCurves *fadeCurves;
+        const FadeCurves *fadeCurves;
 
     private:
-        Resampler resamp_;
         SoftClip clip_;
 
         sample_t* buf_; // output buffer
         unsigned int wrIdx_; // write index
         unsigned int bufFrames_;
         unsigned int bufMask_;
+        // decimated copies of the buffer, or null
+        Mipmap *mip_ = nullptr;
+        // whether writes are being tracked for the mipmap, in this block
+        bool marking_ = false;
+        // mipmap chunks written in this block, not yet flagged
+        static constexpr int MaxMarked = 8;
+        std::array<unsigned int, MaxMarked> marked_;
+        int numMarked_ = 0;
 
         State state_;
         rate_t rate_;
-        int inc_dir_;
-        phase_t phase_;
+        // rate, as a phase increment
+        headphase_t inc_;
+        headphase_t phase_;
         float fade_;
         float trig_; // output trigger value
         bool active_;
         int recOffset_;
 
-        float preFade_;
-        float recFade_;
+        // set when phase is changed, until stored for the next frame
+        bool cutFlag_;
+        // write index at start of current block
+        unsigned int wrIdxBlock_;
+
+        //-- per-block state buffers
+        std::array<headphase_t, MaxBlockFrames> phaseBuf_;
+        std::array<float, MaxBlockFrames> fadeBuf_;
+        std::array<State, MaxBlockFrames> stateBuf_;
+        // frames on which the phase was moved by a cut
+        std::array<bool, MaxBlockFrames> cutBuf_;
+        // frames on which this subhead is allowed to write
+        std::array<bool, MaxBlockFrames> writeBuf_;
+        // pre/rec levels, including fade curves
+        std::array<float, MaxBlockFrames> preBuf_;
+        std::array<float, MaxBlockFrames> recBuf_;
 
         void setRecOffsetSamples(int d);
     };
 
+    //-- per-frame functions, defined here so that block stages can inline them
+
+    inline void SubHead::markWrite(unsigned int idx) {
+        const unsigned int chunk = idx >> Mipmap::ChunkShift;
+        if (numMarked_ > 0 && marked_[numMarked_ - 1] == chunk) {
+            return;
+        }
+        if (numMarked_ == MaxMarked) {
+            endWrite();
+        }
+        marked_[numMarked_++] = chunk;
+    }
+
+    inline Action SubHead::updatePhase(headphase_t start, headphase_t end, bool loop) {
+        Action res = None;
+        trig_ = 0.f;
+        headphase_t p;
+        switch(state_) {
+            case FadeIn:
+            case FadeOut:
+            case Playing:
+                p = phase_ + inc_;
+                if(active_) {
+                    // FIXME: should refactor this a bit.
+                    if (rate_ > 0.f) {
+                        if (p > end || p < start) {
+                            if (loop) {
+                                trig_ = 1.f;
+                                res = LoopPos;
+                            } else {
+                                state_ = FadeOut;
+                                res = Stop;
+                            }
+                        }
+                    } else { // negative rate
+                        if (p > end || p < start) {
+                            if(loop) {
+                                trig_ = 1.f;
+                                res = LoopNeg;
+                            } else {
+                                state_ = FadeOut;
+                                res = Stop;
+                            }
+                        }
+                    } // rate sign check
+                } // /active check
+                phase_ = p;
+                break;
+            case Stopped:
+            default:
+                ;; // nothing to do
+        }
+        return res;
+    }
+
+    inline void SubHead::updateFade(float inc) {
+        switch(state_) {
+            case FadeIn:
+                fade_ += inc;
+                if (fade_ > 1.f) {
+                    fade_ = 1.f;
+                    state_ = Playing;
+                }
+                break;
+            case FadeOut:
+                fade_ -= inc;
+                if (fade_ < 0.f) {
+                    fade_ = 0.f;
+                    state_ = Stopped;
+                }
+                break;
+            case Playing:
+            case Stopped:
+            default:;; // nothing to do
+        }
+    }
+
+    template<bool Write>
+    inline void SubHead::storeFrame(int i, bool write) {
+        phaseBuf_[i] = phase_;
+        fadeBuf_[i] = fade_;
+        if (Write || TraceEnabled) {
+            stateBuf_[i] = state_;
+        }
+        if (Write) {
+            cutBuf_[i] = cutFlag_;
+            writeBuf_[i] = write;
+        }
+        cutFlag_ = false;
+    }
+
+    template<bool Write>
+    inline void SubHead::storeSpan(int i, int n, bool write, float fadeInc) {
+        if (state_ == Stopped) {
+            std::fill(phaseBuf_.begin() + i, phaseBuf_.begin() + i + n, phase_);
+        } else {
+            for (int k=i; k<i+n; ++k) {
+                phaseBuf_[k] = phase_;
+                phase_ += inc_;
+            }
+        }
+        if (state_ == FadeIn) {
+            for (int k=i; k<i+n; ++k) {
+                fadeBuf_[k] = fade_;
+                fade_ += fadeInc;
+            }
+        } else if (state_ == FadeOut) {
+            for (int k=i; k<i+n; ++k) {
+                fadeBuf_[k] = fade_;
+                fade_ -= fadeInc;
+            }
+        } else {
+            std::fill(fadeBuf_.begin() + i, fadeBuf_.begin() + i + n, fade_);
+        }
+        if (Write || TraceEnabled) {
+            std::fill(stateBuf_.begin() + i, stateBuf_.begin() + i + n, state_);
+        }
+        if (Write) {
+            cutBuf_[i] = cutFlag_;
+            std::fill(cutBuf_.begin() + i + 1, cutBuf_.begin() + i + n, false);
+            std::fill(writeBuf_.begin() + i, writeBuf_.begin() + i + n, write);
+        }
+        cutFlag_ = false;
+        trig_ = 0.f;
+    }
+
+    inline void SubHead::setRate(rate_t rate) {
+        rate_ = rate;
+        inc_ = Phase::fromFrames(rate);
+        // NB: write direction and resampler rate follow the rate buffer given to the write stage
+    }
+
 }
 
 
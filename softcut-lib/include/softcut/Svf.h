@@ -9,6 +9,8 @@
 
 #include <memory>
 
+#include "Lanes.h"
+
 class Svf {
 public:
     //---------------
@@ -18,6 +20,11 @@ public:
     void setSampleRate(float sr);
     void setFc(float fc);
     void setRq(float rq);
+    // move the corner frequency, with coefficients ramped linearly over the given number of samples.
+    // tan() comes from a table, so this is cheap enough to follow modulation every few samples.
+    void glideFc(float fc, int samples);
+    // apply the rest of a glide to the coefficients, for samples processed elsewhere (with getCoeffs())
+    void finishGlide();
     void setLpMix(float mix);
     void setHpMix(float mix);
     void setBpMix(float mix);
@@ -25,11 +32,69 @@ public:
 
     float getFc();
 
+    // outputs in the mix, chosen when a mix level changes.
+    // with None, the filter isn't heard, so it isn't run; its state is cleared,
+    // and it restarts from rest (as after an idle block) when a mix is raised.
+    enum class Output { None, Lp, Hp, Bp, Br, Mix };
+    Output getOutput() const { return output; }
+    // as getNextSample() plus dry input, for each of n samples,
+    // computing only the outputs in use.
+    // while not gliding, runs of BlockSamples samples are computed at once
+    // in state-space form (the same filter, but rounded differently).
+    void processFrames(const float *in, float *out, int n, float dry);
+    static constexpr int BlockSamples = softcut::LaneWidth;
+
+    // true once the filter state has decayed to (near) silence
+    bool isDecayed() const;
+    void clear();
+
+    //-- for processing several filters in parallel.
+    // per-sample coefficients and output mix.
+    // while gliding, dg1..dg4 are added to g1..g4 before each sample (otherwise they are 0)
+    struct Coeffs {
+        float g1, g2, g3, g4, rq;
+        float lpMix, hpMix, bpMix, brMix;
+        float dg1, dg2, dg3, dg4;
+    };
+    // state carried between samples
+    struct State {
+        float v0z, v1, v2;
+    };
+    Coeffs getCoeffs() const;
+    State getState() const;
+    void setState(const State &state);
+
 private:
+    void updateOutput();
+    template<Output O>
+    void processFrames(const float *in, float *out, int n, float dry);
+    // whole blocks of BlockSamples samples
+    void processBlocks(const float *in, float *out, int n, float dry);
+    void calcBlockCoeffs();
+
     float lpMix;
     float hpMix;
     float bpMix;
     float brMix;
+    Output output = Output::Mix;
+
+    // coefficient increments, and samples left to apply them (see glideFc())
+    float dg1 = 0.f;
+    float dg2 = 0.f;
+    float dg3 = 0.f;
+    float dg4 = 0.f;
+    int glideSamples = 0;
+
+    // block form of the filter (see processBlocks()), for the coefficients in blockG.
+    // with state s = (v1, v2) and input pairs u[j] = x[j] + x[j-1], each sample is
+    // s' = A s + B u, so after k+1 samples s = A^(k+1) s + sum_j A^(k-j) B u[j].
+    // (g1..g4 are never negative, so the initial values force a calculation)
+    float blockG[4] = {-1.f, -1.f, -1.f, -1.f};
+    // A^(k+1), for k in lanes
+    float blockA11[BlockSamples], blockA12[BlockSamples], blockA21[BlockSamples], blockA22[BlockSamples];
+    // A^m B, preceded by BlockSamples-1 zeros, so that lanes from offset BlockSamples-1-j
+    // are the response to u[j]
+    float blockH1[2 * BlockSamples - 1], blockH2[2 * BlockSamples - 1];
 
     //------------------
     //-- C implementation
@@ -64,6 +129,7 @@ private:
     t_svf svf;
 
     static void svf_calc_coeffs(t_svf* svf);
+    static void svf_calc_gains(t_svf* svf);
     static void svf_init(t_svf* svf);
     static void svf_clear_state(t_svf* svf);
     static void svf_set_sr(t_svf* svf, float sr);
@@ -0,0 +1,96 @@
+//
+// a bank of state variable filters, processed several at once, one filter per SIMD lane.
+//
+// coefficients, output mixes and states are laid out by field (one lanes_t per field
+// for each LaneWidth filters), rather than by filter as in Svf.
+// operations are in the same order as Svf::svf_update(),
+// so each filter produces exactly what the scalar one would sample by sample
+// (Svf::processFrames() instead computes blocks of samples in state-space form,
+// which agrees to within rounding).
+//
+
+#ifndef Softcut_SVFBANK_H
+#define Softcut_SVFBANK_H
+
+#include "Lanes.h"
+#include "Svf.h"
+
+namespace softcut {
+
+    class SvfBank {
+    public:
+        static constexpr int MaxFilters = 16;
+        static constexpr int MaxGroups = (MaxFilters + LaneWidth - 1) / LaneWidth;
+
+        //! @param numFilters: filters in use, up to MaxFilters. the rest of the last group run on zeros
+        explicit SvfBank(int numFilters);
+
+        // take coefficients, output mix and state from a filter. load filters in order from 0.
+        //! @param dryLevel: input level, mixed in after the filter
+        void load(int i, const Svf &svf, float dryLevel);
+        // take coefficients only (with any glide in progress; see Svf::glideFc()).
+        // returns true if the filter is gliding
+        bool loadCoeffs(int i, const Svf &svf);
+        // return the state to the filter (unless it isn't run; see Svf::getOutput())
+        void store(int i, Svf &svf) const;
+
+        // groups of LaneWidth filters in use
+        int numGroups() const { return groups; }
+        // outputs in use, if the same for all filters, or else Mix.
+        // (filters with no outputs then run, but with zero mix levels, and their state is discarded)
+        Svf::Output getOutput() const { return output; }
+
+        // one sample of each filter in a group
+        template<bool Glide, Svf::Output O>
+        lanes_t process(int group, lanes_t in);
+
+    private:
+        struct Group {
+            lanes_t g1, g2, g3, g4, rq;
+            lanes_t lpMix, hpMix, bpMix, brMix;
+            lanes_t dg1, dg2, dg3, dg4;
+            lanes_t v0z, v1, v2;
+            lanes_t dry;
+        };
+        Group bank[MaxGroups];
+        int groups;
+        Svf::Output output;
+    };
+
+    template<bool Glide, Svf::Output O>
+    inline lanes_t SvfBank::process(int group, lanes_t in) {
+        Group &f = bank[group];
+        if (O == Svf::Output::None) {
+            return in * f.dry;
+        }
+        if (Glide) {
+            f.g1 += f.dg1;
+            f.g2 += f.dg2;
+            f.g3 += f.dg3;
+            f.g4 += f.dg4;
+        }
+        const lanes_t v1z = f.v1;
+        const lanes_t v2z = f.v2;
+        const lanes_t v3 = in + f.v0z - 2.f * v2z;
+        f.v1 += f.g1 * v3 - f.g2 * v1z;
+        f.v2 += f.g3 * v3 + f.g4 * v1z;
+        f.v0z = in;
+        switch (O) {
+            case Svf::Output::Lp:
+                return f.v2 * f.lpMix + in * f.dry;
+            case Svf::Output::Hp:
+                return (in - f.rq * f.v1 - f.v2) * f.hpMix + in * f.dry;
+            case Svf::Output::Bp:
+                return f.v1 * f.bpMix + in * f.dry;
+            case Svf::Output::Br:
+                return (in - f.rq * f.v1) * f.brMix + in * f.dry;
+            default: {
+                const lanes_t hp = in - f.rq * f.v1 - f.v2;
+                const lanes_t br = in - f.rq * f.v1;
+                return f.v2 * f.lpMix + hp * f.hpMix + f.v1 * f.bpMix + br * f.brMix + in * f.dry;
+            }
+        }
+    }
+}
+
+#endif //Softcut_SVFBANK_H
@@ -0,0 +1,96 @@
+//
+// per-sample head state tracing, for debugging.
+//
+// only compiled in when SOFTCUT_TRACE is defined to a nonzero value
+// (cmake option SOFTCUT_TRACE, or `waf configure --trace`).
+// the audio thread pushes frames into a lock-free ring per head;
+// a background thread drains every ring to its own file.
+//
+
+#ifndef Softcut_TRACE_H
+#define Softcut_TRACE_H
+
+#ifndef SOFTCUT_TRACE
+#define SOFTCUT_TRACE 0
+#endif
+
+namespace softcut {
+    static constexpr bool TraceEnabled = (SOFTCUT_TRACE != 0);
+}
+
+#if SOFTCUT_TRACE
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace softcut {
+
+    // state of both subheads for one frame
+    struct TraceFrame {
+        float phase[2];
+        float fade[2];
+        float state[2];
+        float pre[2];
+        float rec[2];
+    };
+
+    // single-producer / single-consumer ring of trace frames.
+    // frames pushed while the ring is full are dropped (and counted).
+    class TraceRing {
+    public:
+        TraceRing();
+        ~TraceRing();
+        TraceRing(const TraceRing &) = delete;
+        TraceRing &operator=(const TraceRing &) = delete;
+
+        // audio thread
+        void push(const TraceFrame &frame) {
+            const unsigned int w = writeIdx_.load(std::memory_order_relaxed);
+            const unsigned int r = readIdx_.load(std::memory_order_acquire);
+            if (w - r == numFrames) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            frames_[w & frameMask] = frame;
+            writeIdx_.store(w + 1, std::memory_order_release);
+        }
+
+        // writer thread; returns false if there was nothing to write
+        bool drain();
+
+    private:
+        enum { numFrames = 65536, frameMask = 65535 };
+        std::vector<TraceFrame> frames_;
+        std::atomic<unsigned int> writeIdx_;
+        std::atomic<unsigned int> readIdx_;
+        std::atomic<unsigned int> dropped_;
+        unsigned int droppedReported_;
+        FILE *file_;
+    };
+
+    // background thread draining all live rings
+    class TraceWriter {
+    public:
+        static TraceWriter &instance();
+        ~TraceWriter();
+
+        void add(TraceRing *ring);
+        void remove(TraceRing *ring);
+
+    private:
+        TraceWriter();
+        void run();
+
+        std::mutex mutex_;
+        std::vector<TraceRing *> rings_;
+        std::atomic<bool> quit_;
+        std::thread thread_;
+    };
+}
+
+#endif // SOFTCUT_TRACE
+
+#endif //Softcut_TRACE_H
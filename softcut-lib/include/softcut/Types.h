@@ -9,5 +9,9 @@ namespace softcut {
     typedef float sample_t;
     typedef double phase_t;
     typedef double rate_t;
+
+    // largest number of frames processed in one pass.
+    // per-block state buffers are sized to this; longer blocks are split.
+    static constexpr int MaxBlockFrames = 2048;
 }
 #endif //Softcut_TYPES_H
@@ -8,6 +8,7 @@
 #include <array>
 #include <atomic>
 
+#include "Mipmap.h"
 #include "ReadWriteHead.h"
 #include "Svf.h"
 #include "Utilities.h"
@@ -15,12 +16,22 @@
 
 namespace softcut {
     class Voice {
+        friend class VoiceLanes;
     public:
         Voice();
+        ~Voice();
 
         void init(FadeCurves *fc);
 
+        // (detaches any mipmap; see setMipmap())
         void setBuffer(float *buf, unsigned int numFrames);
+        // read from and maintain decimated copies of the buffer, kept by the given worker (or none).
+        // releases any mipmap held before; call with null before the worker is destroyed,
+        // or before freeing the buffer
+        void setMipmap(MipmapWorker *mips);
+
+        // true if this voice's buffer region overlaps the other's
+        bool sharesBuffer(const Voice &other) const;
 
         void setSampleRate(float hz);
 
@@ -76,15 +87,58 @@ namespace softcut {
 
         void cutToPos(float sec);
 
+        //! follow another voice: take its head positions, fades and states each block,
+        //! so that only reading, writing and levels are computed here.
+        //! rate, loop points, cuts and rec-once then come from the leader.
+        //! the leader must be processed first in each block (see Softcut::processBlocks()).
+        //! @param lead: voice to follow, or nullptr to run independently
+        void setFollow(Voice *lead);
+        bool isFollower() const { return leader != nullptr; }
+        // set while other voices follow this one, so that it stores all head state
+        void setLeading(bool val);
+
+        //! duck: lower output level while reading near another voice's write position.
+        //! the reference publishes its write positions for each run of frames it writes.
+        //! @param ref: voice to take write positions from, or nullptr to stop ducking
+        void setDuck(Voice *ref);
+        bool isDucking() const { return duckRef != nullptr; }
+        // distance from the write position at which ducking begins
+        void setDuckWindow(float sec);
+        // set while other voices duck against this one, so that it publishes write positions
+        void setDuckPublish(bool val);
+
         // process a single channel
         void processBlockMono(const float *in, float *out, int numFrames);
 
+        //-- stages of processBlockMono(), for processing several voices together.
+        //-- for each block: if isIdle(), processIdle();
+        //-- otherwise, for each run of up to MaxBlockFrames,
+        //-- readFrames(), duckFrames(), filterFrames() (or VoiceLanes), writeFrames().
+        //-- then endBlock().
+        // true if the voice would neither read, write nor ring out this block
+        bool isIdle();
+        // minimal state maintenance for an idle voice
+        void processIdle(float *out, int numFrames);
+        // parameter ramps, head positions and reading
+        void readFrames(int numFrames);
+        // output level ducking; reference voices must have read these frames first
+        void duckFrames(int numFrames);
+        // input and output filters
+        void filterFrames(const float *in, float *out, int numFrames);
+        // writing
+        void writeFrames(int numFrames);
+        // per-block bookkeeping
+        void endBlock();
+
         void setRecOffset(float d);
 
         void setRecPreSlewTime(float d);
 
         void setRateSlewTime(float d);
 
+        // interpolation tier for reading and writing
+        void setInterpolation(InterpQuality q);
+
         void setPhaseQuant(float x);
 
         void setPhaseOffset(float x);
@@ -106,7 +160,25 @@ namespace softcut {
 	void stop();
 
     private:
+        // stages specialized for each combination of play and record flags,
+        // so that the mode is selected once per block.
+        template<bool Read, bool Write>
+        void readFrames(int numFrames);
+        template<bool Read, bool Write>
+        void writeFrames(int numFrames);
+
+        // fill a parameter buffer from a ramp.
+        // returns true if the value is constant for the block (ramp was settled)
+        static bool updateRamp(LogRamp &ramp, std::array<float, MaxBlockFrames> &buf, int numFrames);
+
+        // take rate and head state from the leader, in place of computing them
+        void followLeader(int numFrames);
+
+        // input filter corner frequency at a given rate
+        float preSvfFc(float rate) const;
         void updatePreSvfFc();
+        // glide the input filter to follow the rate, over frames [i, i+n) of the rate buffer
+        void trackPreSvfFc(int i, int n);
 
         void updateQuantPhase();
 
@@ -114,9 +186,9 @@ namespace softcut {
         float *buf;
         int bufFrames;
         float sampleRate;
+        // id with FadeCurveRegistry, for the curve set held during a block
+        int fadeReader;
 
-        // fade curve data
-        FadeCurves fadeCurves;
         // xfaded read/write head
         ReadWriteHead sch;
         // input filter
@@ -130,16 +202,58 @@ namespace softcut {
         // record-level ramp
         LogRamp recRamp;
 
+        //-- per-block parameter and signal buffers
+        std::array<float, MaxBlockFrames> rateBuf;
+        std::array<float, MaxBlockFrames> preBuf;
+        std::array<float, MaxBlockFrames> recBuf;
+        // filtered input
+        std::array<float, MaxBlockFrames> inBuf;
+        // head output, before output filter
+        std::array<float, MaxBlockFrames> outBuf;
+        // mode of the frames being processed, fixed by readFrames()
+        bool framesRead;
+        bool framesWrite;
+        // set if pre/rec levels are constant over the frames being processed
+        bool preConst;
+        bool recConst;
+
+        //-- follow mode
+        Voice *leader = nullptr;
+        bool leading = false;
+        // counts runs of updatePositions() with full state, for followers to check
+        unsigned int headSerial = 0;
+        // leader's headSerial when last followed
+        unsigned int followSerial = 0;
+
+        //-- duck mode
+        Voice *duckRef = nullptr;
+        bool duckPublish = false;
+        // counts runs of published write positions, for ducking voices to check
+        unsigned int writePosSerial = 0;
+        // reference's writePosSerial when last ducked
+        unsigned int duckSerial = 0;
+        float duckWindowSec = 0.05f;
+        float duckWindow = 0.05f * 48000;
+        // smoothed duck level, and its pole coefficient
+        float duckLevel = 1.f;
+        float duckPole = tau2pole(duckSlewTime, 48000);
+        static constexpr float duckSlewTime = 0.005f;
+        // write positions, published for ducking voices
+        std::array<phase_t, MaxBlockFrames> writePosBuf;
+        // duck level per frame
+        std::array<float, MaxBlockFrames> duckBuf;
 
         // default frequency for SVF
         // reduced automatically when setting rate
         float svfPreFcBase;
         // the amount by which SVF frequency is modulated by rate
         float svfPreFcMod = 1.0;
+        // interval at which the input filter follows the rate, in frames
+        static constexpr int svfTrackFrames = 16;
         float svfPreDryLevel = 1.0;
         float svfPostDryLevel = 1.0;
         // phase quantization unit, should be in [0,1]
-        phase_t phaseQuant;
+        phase_t phaseQuant = 0;
         // phase offset in sec
         float phaseOffset = 0;
 	
@@ -0,0 +1,32 @@
+//
+// processing stages run across several voices at once, one voice per SIMD lane.
+//
+
+#ifndef Softcut_VOICELANES_H
+#define Softcut_VOICELANES_H
+
+#include "Lanes.h"
+
+namespace softcut {
+    class Voice;
+
+    class VoiceLanes {
+    public:
+        // with this many voices or fewer in all, most lanes of a bank would be empty,
+        // and each voice's own filters are faster (measured: beyond it, banks are faster)
+        static constexpr int MaxSoloVoices = 4;
+
+        // equivalent to calling Voice::filterFrames() on each voice (to within rounding,
+        // where voices are filtered in SIMD lanes rather than in blocks of samples).
+        // results don't depend on how voices are divided between calls.
+        //! @param voices: voices after readFrames(), before writeFrames()
+        //! @param in: input for each voice
+        //! @param out: output for each voice
+        //! @param lanes: filter in SIMD lanes (see SvfBank), or else each voice on its own
+        //! (see Svf::processFrames()). choose from the total number of voices, not those in this call.
+        static void filterFrames(Voice *const *voices, const float *const *in, float *const *out,
+                                 int numVoices, int numFrames, bool lanes);
+    };
+}
+
+#endif //Softcut_VOICELANES_H
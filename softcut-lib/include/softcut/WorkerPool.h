@@ -0,0 +1,66 @@
+//
+// small pool of worker threads, for running independent tasks within one audio block.
+//
+// workers spin for a while after finishing, and then park on a semaphore.
+// the caller never blocks on a lock: handing off work is a few atomic operations
+// (plus a semaphore post for each parked worker), and the caller runs tasks too.
+//
+
+#ifndef Softcut_WORKERPOOL_H
+#define Softcut_WORKERPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace softcut {
+
+    class WorkerPool {
+    public:
+        typedef void (*TaskFn)(void *context, int task);
+
+        //! @param numWorkers: threads in addition to the calling thread
+        //! @param pinThreads: pin each worker to its own core (where supported)
+        explicit WorkerPool(int numWorkers, bool pinThreads = true);
+        ~WorkerPool();
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        // run fn(context, i) for each i in [0, numTasks), on the workers and the calling thread.
+        // returns when all tasks are done. must be called from one thread at a time.
+        // numTasks must be less than 65536.
+        // the first call gives the workers the calling thread's scheduling policy and priority,
+        // since the caller waits for them (a real-time caller must not wait on lower-priority
+        // threads). if that isn't permitted, all tasks run on the calling thread from then on.
+        void run(int numTasks, TaskFn fn, void *context);
+
+        int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+    private:
+        struct Worker;
+        void workerLoop(Worker &w);
+        // take and run tasks until none are left
+        void runTasks();
+        // give workers the calling thread's scheduling. returns false on failure
+        bool matchScheduling();
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<bool> quit;
+        // incremented for each call to run()
+        std::atomic<unsigned int> generation;
+        // next task to take, number of tasks and generation, in one word:
+        // a worker still taking tasks from one run can't claim one from the next.
+        std::atomic<uint64_t> claim;
+        std::atomic<int> remaining;
+        std::atomic<TaskFn> fn;
+        std::atomic<void *> context;
+        //-- calling thread only:
+        bool schedMatched;
+        // false if workers couldn't be given the caller's scheduling
+        bool parallel;
+    };
+}
+
+#endif //Softcut_WORKERPOOL_H
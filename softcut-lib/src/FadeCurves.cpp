@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <boost/assert.hpp>
 #include <cstring>
+#include <thread>
 
 #include "softcut/Interpolate.h"
 #include "softcut/FadeCurves.h"
@@ -25,12 +26,27 @@ FadeCurves::Shape FadeCurves::preShape = Linear;
 */
 
 void FadeCurves::init() {
-    setPreShape(FadeCurves::Shape::Linear);
-    setRecShape(FadeCurves::Shape::Raised);
-    setMinPreWindowFrames(0);
-    setMinRecDelayFrames(0);
-    setPreWindowRatio(1.f / 8);
-    setRecDelayRatio(1.f / (8 * 16));
+    // (set everything before calculating; each curve depends on several fields)
+    preShape = FadeCurves::Shape::Linear;
+    recShape = FadeCurves::Shape::Raised;
+    preWindowMinFrames = 0;
+    recDelayMinFrames = 0;
+    preWindowRatio = 1.f / 8;
+    recDelayRatio = 1.f / (8 * 16);
+    calcPreFade();
+    calcRecFade();
+    calcXfade();
+}
+
+void FadeCurves::calcXfade() {
+    // table lookup maps [0, 1] to [0, n], with one guard point after
+    const unsigned int n = fadeBufSize - 2;
+    const float phi = fpi / (2 * n);
+    for (unsigned int i = 0; i < n; ++i) {
+        xfadeBuf[i] = sinf(phi * i);
+    }
+    xfadeBuf[n] = 1.f;
+    xfadeBuf[n+1] = 1.f;
 }
 
 void FadeCurves::calcRecFade() {
@@ -143,15 +159,6 @@ void FadeCurves::setMinPreWindowFrames(unsigned int x) {
     calcPreFade();
 }
 
-float FadeCurves::getRecFadeValue(float x) {
-    return Interpolate::tabLinear<float, fadeBufSize>(recFadeBuf, x);
-}
-
-
-float FadeCurves::getPreFadeValue(float x) {
-    return Interpolate::tabLinear<float, fadeBufSize>(preFadeBuf, x);
-}
-
 void FadeCurves::setPreShape(FadeCurves::Shape x) {
     preShape = x;
     calcPreFade();
@@ -161,3 +168,109 @@ void FadeCurves::setRecShape(FadeCurves::Shape x) {
     recShape = x;
     calcRecFade();
 }
+
+FadeCurveRegistry &FadeCurveRegistry::instance() {
+    static FadeCurveRegistry registry;
+    return registry;
+}
+
+namespace {
+    // reader state between blocks
+    constexpr unsigned int Idle = ~0u;
+}
+
+FadeCurveRegistry::FadeCurveRegistry() : epoch_(0), readerUsed_(), untracked_(0) {
+    std::unique_ptr<FadeCurves> fc(new FadeCurves);
+    fc->init();
+    current_.store(fc.get(), std::memory_order_release);
+    sets_.push_back(Set { std::move(fc), 0 });
+    for (auto &r : readers_) {
+        r.store(Idle, std::memory_order_relaxed);
+    }
+}
+
+int FadeCurveRegistry::addReader() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < MaxReaders; ++i) {
+        if (!readerUsed_[i]) {
+            readerUsed_[i] = true;
+            readers_[i].store(Idle);
+            return i;
+        }
+    }
+    ++untracked_;
+    return -1;
+}
+
+void FadeCurveRegistry::removeReader(int reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reader < 0) {
+        --untracked_;
+        return;
+    }
+    readers_[reader].store(Idle);
+    readerUsed_[reader] = false;
+}
+
+// (sequentially consistent: update() either sees a reader's epoch,
+// or the reader sees the set published before update() looked)
+const FadeCurves *FadeCurveRegistry::beginRead(int reader) {
+    if (reader >= 0) {
+        readers_[reader].store(epoch_.load());
+    }
+    return current_.load();
+}
+
+void FadeCurveRegistry::endRead(int reader) {
+    if (reader >= 0) {
+        readers_[reader].store(Idle, std::memory_order_release);
+    }
+}
+
+void FadeCurveRegistry::update(const std::function<void(FadeCurves &)> &change) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<FadeCurves> fc(new FadeCurves(*current()));
+    change(*fc);
+    const unsigned int epoch = epoch_.load(std::memory_order_relaxed) + 1;
+    current_.store(fc.get());
+    epoch_.store(epoch);
+    sets_.push_back(Set { std::move(fc), epoch });
+    if (untracked_ > 0 || sets_.size() <= 2) {
+        return;
+    }
+    // sets before the last two were replaced by the time the previous set was published.
+    // a reader holds a set no older than the one current when it began, so only readers
+    // that began before then can hold them. (normally there are none; otherwise
+    // they are within a block, so this waits for less than a block)
+    const unsigned int replaced = sets_[sets_.size() - 2].epoch;
+    for (auto &r : readers_) {
+        while (r.load() < replaced) {
+            std::this_thread::yield();
+        }
+    }
+    sets_.erase(sets_.begin(), sets_.end() - 2);
+}
+
+void FadeCurveRegistry::setRecDelayRatio(float x) {
+    update([x](FadeCurves &fc) { fc.setRecDelayRatio(x); });
+}
+
+void FadeCurveRegistry::setPreWindowRatio(float x) {
+    update([x](FadeCurves &fc) { fc.setPreWindowRatio(x); });
+}
+
+void FadeCurveRegistry::setMinRecDelayFrames(unsigned int x) {
+    update([x](FadeCurves &fc) { fc.setMinRecDelayFrames(x); });
+}
+
+void FadeCurveRegistry::setMinPreWindowFrames(unsigned int x) {
+    update([x](FadeCurves &fc) { fc.setMinPreWindowFrames(x); });
+}
+
+void FadeCurveRegistry::setPreShape(FadeCurves::Shape x) {
+    update([x](FadeCurves &fc) { fc.setPreShape(x); });
+}
+
+void FadeCurveRegistry::setRecShape(FadeCurves::Shape x) {
+    update([x](FadeCurves &fc) { fc.setRecShape(x); });
+}
@@ -0,0 +1,45 @@
+//
+// polyphase table for windowed-sinc interpolation
+//
+
+#include <cmath>
+
+#include "softcut/Interpolate.h"
+
+using namespace softcut;
+
+float InterpSinc::table[(InterpSinc::Phases + 1) * InterpSinc::Taps];
+
+namespace {
+    struct SincTableInit {
+        SincTableInit() {
+            constexpr int taps = InterpSinc::Taps;
+            constexpr int phases = InterpSinc::Phases;
+            constexpr int half = taps / 2;
+            const double pi = 3.14159265358979323846;
+            for (int p = 0; p <= phases; ++p) {
+                const double x = static_cast<double>(p) / phases;
+                float *h = InterpSinc::table + p * taps;
+                double c[taps];
+                double sum = 0.0;
+                for (int k = 0; k < taps; ++k) {
+                    // distance from the interpolated point to tap k
+                    const double t = static_cast<double>(k - (half - 1)) - x;
+                    // (zero crossings are exact, so that phases on a frame return the frame)
+                    const double sinc = (t == 0.0) ? 1.0
+                                        : (t == std::floor(t)) ? 0.0 : std::sin(pi * t) / (pi * t);
+                    // blackman window over [-half, half]
+                    const double w = 0.42 + 0.5 * std::cos(pi * t / half) + 0.08 * std::cos(2.0 * pi * t / half);
+                    c[k] = sinc * w;
+                    sum += c[k];
+                }
+                // unity gain at DC
+                for (int k = 0; k < taps; ++k) {
+                    h[k] = static_cast<float>(c[k] / sum);
+                }
+            }
+        }
+    };
+
+    const SincTableInit sincTableInit;
+}
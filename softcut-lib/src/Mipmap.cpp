@@ -0,0 +1,256 @@
+//
+// decimated buffer levels (see Mipmap.h)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "softcut/Mipmap.h"
+
+using namespace softcut;
+
+namespace {
+    // half-band lowpass for decimating by 2: windowed sinc, cutoff at half nyquist.
+    // taps at even distances from the center are zero, so only the center
+    // and odd distances 1, 3, .. HalfTaps*2-1 are kept.
+    static constexpr int HalfTaps = 8;
+
+    struct Halfband {
+        float center;
+        float odd[HalfTaps];
+
+        Halfband() {
+            const double pi = 3.14159265358979323846;
+            const int reach = HalfTaps * 2;
+            double sum = 0.5;
+            for (int k = 0; k < HalfTaps; ++k) {
+                const double t = 2 * k + 1;
+                const double sinc = std::sin(pi * t / 2) / (pi * t);
+                // blackman window over [-reach, reach]
+                const double w = 0.42 + 0.5 * std::cos(pi * t / reach) + 0.08 * std::cos(2 * pi * t / reach);
+                odd[k] = static_cast<float>(sinc * w);
+                sum += 2 * sinc * w;
+            }
+            // unity gain at DC
+            center = static_cast<float>(0.5 / sum);
+            for (float &h : odd) {
+                h = static_cast<float>(h / sum);
+            }
+        }
+    };
+
+    const Halfband halfband;
+
+    // filter and decimate frames [lo, hi) of dst (wrapping) from src, which has twice as many frames
+    void decimate(const sample_t *src, unsigned int srcFrames, sample_t *dst, int lo, int hi) {
+        const unsigned int srcMask = srcFrames - 1;
+        const unsigned int dstMask = (srcFrames >> 1) - 1;
+        for (int j = lo; j < hi; ++j) {
+            const unsigned int c = static_cast<unsigned int>(2 * j) & srcMask;
+            float y = halfband.center * src[c];
+            for (int k = 0; k < HalfTaps; ++k) {
+                const unsigned int d = 2 * k + 1;
+                y += halfband.odd[k] * (src[(c - d) & srcMask] + src[(c + d) & srcMask]);
+            }
+            dst[static_cast<unsigned int>(j) & dstMask] = y;
+        }
+    }
+
+    // interval between refresh passes
+    static constexpr std::chrono::milliseconds refreshInterval(5);
+    // longest a region being written waits for a refresh, in passes
+    static constexpr int maxDeferredPasses = 20;
+    // smallest level kept, in frames
+    static constexpr unsigned int minLevelFrames = 1 << Mipmap::ChunkShift;
+    // hysteresis in choosing a level, as a ratio of rates (a semitone)
+    static constexpr double levelMargin = 1.0594630943592953;
+}
+
+int Mipmap::levelForRate(rate_t rate, int current) const {
+    if (state.load(std::memory_order_acquire) != Ready) {
+        return 0;
+    }
+    const rate_t r = std::fabs(rate);
+    const int level = (r <= 2.0) ? 0 : std::min(std::ilogb(r), numLevels);
+    if (level == current || current < 0 || current > numLevels) {
+        return level;
+    }
+    // range of the current level, widened by the margin
+    const rate_t lo = (current == 0) ? 0.0 : std::ldexp(1.0, current) / levelMargin;
+    const rate_t hi = (current == numLevels) ? HUGE_VAL : std::ldexp(2.0, current) * levelMargin;
+    return (r >= lo && r <= hi) ? current : level;
+}
+
+MipmapWorker::MipmapWorker(int numLevels) :
+        numLevels(std::max(1, std::min(numLevels, static_cast<int>(Mipmap::MaxLevels)))), quit(false) {
+    thread = std::thread([this] { run(); });
+}
+
+MipmapWorker::~MipmapWorker() {
+    quit = true;
+    thread.join();
+}
+
+Mipmap *MipmapWorker::attach(const sample_t *buf, unsigned int frames) {
+    if (buf == nullptr) {
+        return nullptr;
+    }
+    for (auto &m : mips) {
+        if (m.source.load(std::memory_order_acquire) != buf || m.frames != frames) {
+            continue;
+        }
+        // a mipmap with no holds left is being freed; don't revive it
+        int users = m.users.load(std::memory_order_relaxed);
+        while (users > 0) {
+            if (m.users.compare_exchange_weak(users, users + 1, std::memory_order_acq_rel)) {
+                return &m;
+            }
+        }
+    }
+    for (auto &m : mips) {
+        const sample_t *expected = nullptr;
+        if (m.source.compare_exchange_strong(expected, buf)) {
+            m.frames = frames;
+            m.users.store(1, std::memory_order_relaxed);
+            m.state.store(Mipmap::Claimed, std::memory_order_release);
+            return &m;
+        }
+    }
+    return nullptr;
+}
+
+bool MipmapWorker::isHeld(const sample_t *buf) const {
+    for (auto &m : mips) {
+        if (m.source.load(std::memory_order_acquire) == buf) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Mipmap::release() {
+    if (users.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        state.store(Released, std::memory_order_release);
+    }
+}
+
+void MipmapWorker::markChanged(const sample_t *buf) {
+    for (auto &m : mips) {
+        if (m.source.load(std::memory_order_acquire) == buf && m.isTracking()) {
+            for (unsigned int c = 0; c < m.numChunks; c += 32) {
+                const unsigned int n = m.numChunks - c;
+                m.dirty[c >> 5].store(n >= 32 ? ~0u : (1u << n) - 1, std::memory_order_release);
+            }
+        }
+    }
+}
+
+void MipmapWorker::run() {
+    while (!quit) {
+        for (auto &m : mips) {
+            const int state = m.state.load(std::memory_order_acquire);
+            if (state == Mipmap::Free) {
+                continue;
+            }
+            if (state == Mipmap::Released) {
+                // free on the next pass, after any block still reading from it
+                if (m.releaseSeen) {
+                    clear(m);
+                } else {
+                    m.releaseSeen = true;
+                }
+                continue;
+            }
+            if (state == Mipmap::Claimed) {
+                build(m);
+                continue;
+            }
+            // chunks still being written are left until the writing moves on
+            // (refreshing them would contend with the writer for the same cache lines),
+            // or until they have waited too long
+            const bool flush = ++m.deferredPasses >= maxDeferredPasses;
+            if (flush) {
+                m.deferredPasses = 0;
+            }
+            const unsigned int numWords = (m.numChunks + 31) / 32;
+            for (unsigned int w = 0; w < numWords; ++w) {
+                const uint32_t fresh = m.dirty[w].exchange(0, std::memory_order_acquire);
+                uint32_t bits = flush ? (m.pending[w] | fresh) : (m.pending[w] & ~fresh);
+                m.pending[w] = (m.pending[w] | fresh) & ~bits;
+                while (bits != 0) {
+                    const int b = __builtin_ctz(bits);
+                    bits &= bits - 1;
+                    refresh(m, w * 32 + b);
+                }
+            }
+            refresh(m, m.sweepChunk);
+            m.sweepChunk = (m.sweepChunk + 1) % m.numChunks;
+        }
+        std::this_thread::sleep_for(refreshInterval);
+    }
+}
+
+void MipmapWorker::build(Mipmap &m) {
+    m.numChunks = std::max(1u, m.frames >> Mipmap::ChunkShift);
+    m.dirty.reset(new std::atomic<uint32_t>[(m.numChunks + 31) / 32]);
+    m.pending.reset(new uint32_t[(m.numChunks + 31) / 32]());
+    for (unsigned int w = 0; w < (m.numChunks + 31) / 32; ++w) {
+        m.dirty[w].store(0, std::memory_order_relaxed);
+    }
+    m.sweepChunk = 0;
+    m.deferredPasses = 0;
+    // writes from here on are flagged, so anything the full pass misses is refreshed later.
+    // (if the last hold has already gone, leave the mipmap to be freed)
+    int claimed = Mipmap::Claimed;
+    if (!m.state.compare_exchange_strong(claimed, Mipmap::Tracking, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    m.numLevels = 0;
+    const sample_t *src = m.source.load(std::memory_order_relaxed);
+    unsigned int srcFrames = m.frames;
+    while (m.numLevels < numLevels && (srcFrames >> 1) >= minLevelFrames) {
+        std::vector<sample_t> &level = m.levels[m.numLevels];
+        level.assign(srcFrames >> 1, 0.f);
+        decimate(src, srcFrames, level.data(), 0, static_cast<int>(srcFrames >> 1));
+        src = level.data();
+        srcFrames >>= 1;
+        ++m.numLevels;
+    }
+    int tracking = Mipmap::Tracking;
+    m.state.compare_exchange_strong(tracking, Mipmap::Ready, std::memory_order_acq_rel);
+}
+
+void MipmapWorker::refresh(Mipmap &m, unsigned int chunk) {
+    // frames of each level affected by the chunk, widened by the filter reach at each step
+    const int reach = HalfTaps * 2 - 1;
+    int lo = static_cast<int>(chunk << Mipmap::ChunkShift);
+    int hi = lo + (1 << Mipmap::ChunkShift);
+    const sample_t *src = m.source.load(std::memory_order_relaxed);
+    unsigned int srcFrames = m.frames;
+    for (int l = 0; l < m.numLevels; ++l) {
+        // (arithmetic shift rounds down for negative frames, which wrap)
+        lo = (lo - reach) >> 1;
+        hi = ((hi + reach) >> 1) + 1;
+        hi = std::min(hi, lo + static_cast<int>(srcFrames >> 1));
+        sample_t *dst = m.levels[l].data();
+        decimate(src, srcFrames, dst, lo, hi);
+        src = dst;
+        srcFrames >>= 1;
+    }
+}
+
+void MipmapWorker::clear(Mipmap &m) {
+    for (auto &level : m.levels) {
+        std::vector<sample_t>().swap(level);
+    }
+    m.numLevels = 0;
+    m.dirty.reset();
+    m.pending.reset();
+    m.numChunks = 0;
+    m.releaseSeen = false;
+    // the slot stays taken (by source) until it is free
+    m.state.store(Mipmap::Free, std::memory_order_release);
+    m.source.store(nullptr, std::memory_order_release);
+}
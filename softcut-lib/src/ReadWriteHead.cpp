@@ -1,6 +1,7 @@
 //
 // Created by ezra on 12/6/17.
 //
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
@@ -13,82 +14,339 @@
 using namespace softcut;
 using namespace std;
 
-void ReadWriteHead::init(FadeCurves *fc) {
-    start = 0.f;
-    end = 0.f;
+namespace {
+    // fade position of a subhead over a whole block
+    enum class FadeSpan { Silent, Full, Mixed };
+
+    FadeSpan classifyFade(const float *fade, int numFrames) {
+        bool silent = true;
+        bool full = true;
+        for (int i=0; i<numFrames; ++i) {
+            silent &= (fade[i] == 0.f);
+            full &= (fade[i] == 1.f);
+        }
+        return silent ? FadeSpan::Silent : (full ? FadeSpan::Full : FadeSpan::Mixed);
+    }
+}
+
+void ReadWriteHead::init(const FadeCurves *fc) {
+    start = Phase::fromFrames(0);
+    end = Phase::fromFrames(0);
     active = 0;
     rate = 1.f;
+    readLevel = 0;
+    interp = InterpQuality::Hermite;
+    fadeCurves = fc;
     setFadeTime(0.1f);
-    testBuf.init();
     queuedCrossfade = 0;
     queuedCrossfadeFlag = false;
     head[0].init(fc);
     head[1].init(fc);
+    head[0].setRate(rate);
+    head[1].setRate(rate);
+    resamp.setPhase(0);
+    writeRate = rate;
+    resamp.setRate(writeRate);
 
     setRecOnceFlag(false);
 }
 
-void ReadWriteHead::processSample(sample_t in, sample_t *out) {
-    *out = mixFade(head[0].peek(), head[1].peek(), head[0].fade(), head[1].fade());
+void ReadWriteHead::setFadeCurves(const FadeCurves *fc) {
+    fadeCurves = fc;
+    head[0].fadeCurves = fc;
+    head[1].fadeCurves = fc;
+}
 
-    BOOST_ASSERT_MSG(!(head[0].state_ == Playing && head[1].state_ == Playing), "multiple active heads");
+template<bool Write>
+void ReadWriteHead::updatePositions(const float *rateBuf, int numFrames) {
+    head[0].beginBlock();
+    head[1].beginBlock();
+    bool fadeIncDirty = false;
+    int i = 0;
+    while (i < numFrames) {
+        // between events, frames are stored without per-frame checks
+        const int n = fadeIncDirty ? 0 : framesToEvent(rateBuf, i, numFrames);
+        if (n > 0) {
+            if (Write && (recOnceFlag || recOnceDone || (recOnceHead > -1))) {
+                head[0].storeSpan<Write>(i, n, recOnceHead == 0, fadeInc);
+                head[1].storeSpan<Write>(i, n, recOnceHead == 1, fadeInc);
+            } else {
+                head[0].storeSpan<Write>(i, n, true, fadeInc);
+                head[1].storeSpan<Write>(i, n, true, fadeInc);
+            }
+            i += n;
+            continue;
+        }
 
-    if (recOnceFlag || recOnceDone || (recOnceHead > -1)) {
-        if (recOnceHead > -1) {
-            head[recOnceHead].poke(in, pre, rec);
+        // subhead phase increments follow every change in rate;
+        // fade increment only needs to keep up once per interval
+        const rate_t r = rateBuf[i];
+        if (r != rate) {
+            rate = r;
+            head[0].setRate(r);
+            head[1].setRate(r);
+            fadeIncDirty = true;
         }
-    } else {
-        head[0].poke(in, pre, rec);
-        head[1].poke(in, pre, rec);
+        if (fadeIncDirty && (i % fadeIncInterval) == 0) {
+            calcFadeInc();
+            fadeIncDirty = false;
+        }
+
+        BOOST_ASSERT_MSG(!(head[0].state_ == Playing && head[1].state_ == Playing), "multiple active heads");
+
+        if (Write && (recOnceFlag || recOnceDone || (recOnceHead > -1))) {
+            head[0].storeFrame<Write>(i, recOnceHead == 0);
+            head[1].storeFrame<Write>(i, recOnceHead == 1);
+        } else {
+            head[0].storeFrame<Write>(i, true);
+            head[1].storeFrame<Write>(i, true);
+        }
+
+        takeAction(head[0].updatePhase(start, end, loopFlag));
+        takeAction(head[1].updatePhase(start, end, loopFlag));
+
+        head[0].updateFade(fadeInc);
+        head[1].updateFade(fadeInc);
+        dequeueCrossfade();
+        ++i;
     }
+    if (fadeIncDirty) {
+        calcFadeInc();
+    }
+}
 
-    takeAction(head[0].updatePhase(start, end, loopFlag));
-    takeAction(head[1].updatePhase(start, end, loopFlag));
+int ReadWriteHead::framesToEvent(const float *rateBuf, int i, int numFrames) {
+    // a queued cut is taken as soon as the active subhead isn't fading
+    if (queuedCrossfadeFlag) {
+        const State s = head[active].state();
+        if (!(s == State::FadeIn || s == State::FadeOut)) {
+            return 0;
+        }
+    }
+    // rate changes are applied frame by frame
+    int n = 0;
+    while (i + n < numFrames && rateBuf[i + n] == rate) {
+        ++n;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    n = head[0].framesToEvent(start, end, fadeInc, n);
+    return head[1].framesToEvent(start, end, fadeInc, n);
+}
 
-    head[0].updateFade(fadeInc);
-    head[1].updateFade(fadeInc);
-    dequeueCrossfade();
+template void ReadWriteHead::updatePositions<true>(const float *rateBuf, int numFrames);
+template void ReadWriteHead::updatePositions<false>(const float *rateBuf, int numFrames);
+
+void ReadWriteHead::followPositions(const ReadWriteHead &lead, int numFrames, bool moved) {
+    // loop points, cut queue and rec-once state all belong to the leader
+    start = lead.start;
+    end = lead.end;
+    queuedCrossfade = lead.queuedCrossfade;
+    queuedCrossfadeFlag = lead.queuedCrossfadeFlag;
+    fadeTime = lead.fadeTime;
+    fadeInc = lead.fadeInc;
+    active = lead.active;
+    loopFlag = lead.loopFlag;
+    recOnceFlag = lead.recOnceFlag;
+    recOnceDone = lead.recOnceDone;
+    recOnceHead = lead.recOnceHead;
+    rate = lead.rate;
+    for (int h=0; h<2; ++h) {
+        head[h].beginBlock();
+        head[h].followFrames(lead.head[h], numFrames, moved);
+    }
 }
 
+void ReadWriteHead::getWritePositions(const float *rateBuf, phase_t *pos, int numFrames) {
+    for (int i=0; i<numFrames; ++i) {
+        // (offset on the side the write path puts it, frame by frame)
+        const int dir = boost::math::sign(rateBuf[i]);
+        const int h = head[1].fadeBuf_[i] > head[0].fadeBuf_[i] ? 1 : 0;
+        pos[i] = Phase::toFrames(head[h].phaseBuf_[i]) + dir * head[h].recOffset_;
+    }
+}
 
-void ReadWriteHead::processSampleNoRead(sample_t in, sample_t *out) {
-    (void)out;
+void ReadWriteHead::calcDuck(const phase_t *ref, float window, float *level, int numFrames) {
+    const phase_t frames = head[0].bufFrames_;
+    const float scale = 1.f / std::max(window, 1.f);
+    for (int i=0; i<numFrames; ++i) {
+        const int h = head[1].fadeBuf_[i] > head[0].fadeBuf_[i] ? 1 : 0;
+        // distance around the buffer
+        phase_t d = std::fabs(std::fmod(Phase::toFrames(head[h].phaseBuf_[i]) - ref[i], frames));
+        d = std::min(d, frames - d);
+        const float x = static_cast<float>(d) * scale;
+        level[i] = x < 1.f ? fadeCurves->getXfadeValue(x) : 1.f;
+    }
+}
 
-    BOOST_ASSERT_MSG(!(head[0].state_ == Playing && head[1].state_ == Playing), "multiple active heads");
+void ReadWriteHead::updateLevels(const float *pre, const float *rec, int numFrames) {
+    head[0].calcLevels(pre, rec, numFrames);
+    head[1].calcLevels(pre, rec, numFrames);
+}
+
+void ReadWriteHead::peekBlock(sample_t *out, int numFrames) {
+    switch (interp) {
+        case InterpQuality::Linear:
+            peekBlockInterp<InterpLinear>(out, numFrames);
+            break;
+        case InterpQuality::Hermite:
+            peekBlockInterp<InterpHermite>(out, numFrames);
+            break;
+        case InterpQuality::Sinc:
+            peekBlockInterp<InterpSinc>(out, numFrames);
+            break;
+    }
+}
+
+template<class Interp>
+void ReadWriteHead::peekBlockInterp(sample_t *out, int numFrames) {
+    const int level = (head[0].mip_ != nullptr) ? head[0].mip_->levelForRate(rate, readLevel) : 0;
+    peekLevel<Interp>(out, numFrames, level);
+    if (level == readLevel) {
+        return;
+    }
+    // crossfade from the level read until now, over the block.
+    // (levels are filtered copies of the same signal, so a linear fade keeps the level)
+    peekLevel<Interp>(levelBuf.data(), numFrames, readLevel);
+    const float inc = 1.f / static_cast<float>(numFrames);
+    for (int i=0; i<numFrames; ++i) {
+        const float x = static_cast<float>(i + 1) * inc;
+        out[i] = levelBuf[i] + (out[i] - levelBuf[i]) * x;
+    }
+    readLevel = level;
+}
 
-    if (recOnceFlag || recOnceDone || (recOnceHead > -1)) {
-        if (recOnceHead > -1) {
-            head[recOnceHead].poke(in, pre, rec);
+template<class Interp>
+void ReadWriteHead::peekLevel(sample_t *out, int numFrames, int level) {
+    const float *fade0 = head[0].fadeBuf_.data();
+    const float *fade1 = head[1].fadeBuf_.data();
+    const FadeSpan span0 = classifyFade(fade0, numFrames);
+    const FadeSpan span1 = classifyFade(fade1, numFrames);
+
+    // usually at most one subhead is audible; then skip reading the other
+    if (span0 == FadeSpan::Silent || span1 == FadeSpan::Silent) {
+        const int h = (span0 == FadeSpan::Silent) ? 1 : 0;
+        const FadeSpan span = (h == 0) ? span0 : span1;
+        if (span == FadeSpan::Silent) {
+            std::fill(out, out + numFrames, 0.f);
+            return;
         }
-    } else {
-        head[0].poke(in, pre, rec);
-        head[1].poke(in, pre, rec);
+        head[h].peekBlock<Interp>(out, numFrames, level);
+        if (span == FadeSpan::Mixed) {
+            const float *fade = head[h].fadeBuf_.data();
+            for (int i=0; i<numFrames; ++i) {
+                out[i] *= fadeCurves->getXfadeValue(fade[i]);
+            }
+        }
+        return;
     }
 
-    takeAction(head[0].updatePhase(start, end, loopFlag));
-    takeAction(head[1].updatePhase(start, end, loopFlag));
+    head[0].peekBlock<Interp>(readBuf[0].data(), numFrames, level);
+    head[1].peekBlock<Interp>(readBuf[1].data(), numFrames, level);
+    for (int i=0; i<numFrames; ++i) {
+        out[i] = mixFade(readBuf[0][i], readBuf[1][i], fade0[i], fade1[i]);
+    }
+}
 
-    head[0].updateFade(fadeInc);
-    head[1].updateFade(fadeInc);
-    dequeueCrossfade();
+bool ReadWriteHead::isUnityWrite(const float *rate, int numFrames) {
+    return std::fabs(writeRate) == 1.0 && resamp.isUnity()
+           && std::all_of(rate, rate + numFrames, [this](float r) { return r == writeRate; });
 }
 
-void ReadWriteHead::processSampleNoWrite(sample_t in, sample_t *out) {
-    (void)in;
-    *out = mixFade(head[0].peek(), head[1].peek(), head[0].fade(), head[1].fade());
+void ReadWriteHead::pokeBlock(const sample_t *in, const float *rate, int numFrames) {
+    switch (interp) {
+        case InterpQuality::Linear:
+            pokeBlockInterp<InterpLinear>(in, rate, numFrames);
+            break;
+        case InterpQuality::Hermite:
+            pokeBlockInterp<InterpHermite>(in, rate, numFrames);
+            break;
+        case InterpQuality::Sinc:
+            pokeBlockInterp<InterpSinc>(in, rate, numFrames);
+            break;
+    }
+}
 
-    BOOST_ASSERT_MSG(!(head[0].state_ == Playing && head[1].state_ == Playing), "multiple active heads");
+template<class Interp>
+void ReadWriteHead::pokeBlockInterp(const sample_t *in, const float *rate, int numFrames) {
+    head[0].beginWrite();
+    head[1].beginWrite();
+    if (isUnityWrite(rate, numFrames)) {
+        for (int i=0; i<numFrames; ++i) {
+            resampOut[i] = resamp.processFrameUnity<Interp>(in[i]);
+        }
+        const int dir = boost::math::sign(writeRate);
+        head[0].pokeFramesUnity(resampOut.data(), dir, numFrames);
+        head[1].pokeFramesUnity(resampOut.data(), dir, numFrames);
+        head[0].endWrite();
+        head[1].endWrite();
+        return;
+    }
+    // each subhead only writes on the frames it is allowed to
+    int i = 0;
+    while (i < numFrames) {
+        const int n = resamp.processBlock<Interp>(in + i, rate + i, numFrames - i,
+                                                  resampOut.data(), resampCount.data());
+        head[0].pokeFrames(resampOut.data(), resampCount.data(), rate, i, n);
+        head[1].pokeFrames(resampOut.data(), resampCount.data(), rate, i, n);
+        i += n;
+    }
+    head[0].endWrite();
+    head[1].endWrite();
+    writeRate = rate[numFrames-1];
+}
 
-    takeAction(head[0].updatePhase(start, end, loopFlag));
-    takeAction(head[1].updatePhase(start, end, loopFlag));
+void ReadWriteHead::traceBlock(int numFrames, bool write) {
+#if SOFTCUT_TRACE
+    TraceFrame f;
+    for (int i=0; i<numFrames; ++i) {
+        for (int h=0; h<2; ++h) {
+            f.phase[h] = static_cast<float>(Phase::toFrames(head[h].phaseBuf_[i]));
+            f.fade[h] = head[h].fadeBuf_[i];
+            f.state[h] = static_cast<float>(head[h].stateBuf_[i]);
+            // without writing, buffer content is left as is
+            f.pre[h] = write ? head[h].preBuf_[i] : 1.f;
+            f.rec[h] = write ? head[h].recBuf_[i] : 0.f;
+        }
+        trace.push(f);
+    }
+#else
+    (void)numFrames;
+    (void)write;
+#endif
+}
 
-    head[0].updateFade(fadeInc);
-    head[1].updateFade(fadeInc);
-    dequeueCrossfade();
+void ReadWriteHead::skipBlock(const sample_t *in, const float *rate, int numFrames) {
+    head[0].beginWrite();
+    head[1].beginWrite();
+    // output frame counts don't depend on interpolation,
+    // so take the cheapest; input history is kept in full regardless
+    if (isUnityWrite(rate, numFrames)) {
+        for (int i=0; i<numFrames; ++i) {
+            resamp.processFrameUnity<InterpLinear>(in[i]);
+        }
+        std::fill(resampCount.begin(), resampCount.begin() + numFrames, 1);
+        head[0].skipFrames(resampCount.data(), rate, 0, numFrames);
+        head[1].skipFrames(resampCount.data(), rate, 0, numFrames);
+        return;
+    }
+    int i = 0;
+    while (i < numFrames) {
+        const int n = resamp.processBlock<InterpLinear>(in + i, rate + i, numFrames - i,
+                                                        nullptr, resampCount.data());
+        head[0].skipFrames(resampCount.data(), rate, i, n);
+        head[1].skipFrames(resampCount.data(), rate, i, n);
+        i += n;
+    }
+    writeRate = rate[numFrames-1];
 }
 
 void ReadWriteHead::setRate(rate_t x)
 {
+    if (x == rate) {
+        return;
+    }
     rate = x;
     calcFadeInc();
     head[0].setRate(x);
@@ -97,13 +355,13 @@ void ReadWriteHead::setRate(rate_t x)
 
 void ReadWriteHead::setLoopStartSeconds(float x)
 {
-    start = x * sr;
+    start = Phase::fromFrames(x * sr);
     queuedCrossfadeFlag = false;
 }
 
 void ReadWriteHead::setLoopEndSeconds(float x)
 {
-    end = x * sr;
+    end = Phase::fromFrames(x * sr);
     queuedCrossfadeFlag = false;
 }
 
@@ -111,10 +369,10 @@ void ReadWriteHead::takeAction(Action act)
 {
     switch (act) {
         case Action::LoopPos:
-            enqueueCrossfade(start);
+            enqueueCrossfade(Phase::toFrames(start));
             break;
         case Action::LoopNeg:
-            enqueueCrossfade(end);
+            enqueueCrossfade(Phase::toFrames(end));
             break;
         case Action::Stop:
             break;
@@ -186,6 +444,13 @@ void ReadWriteHead::setBuffer(float *b, uint32_t bf) {
     head[1].setBuffer(b, bf);
 }
 
+void ReadWriteHead::setMipmap(Mipmap *mip) {
+    head[0].setMipmap(mip);
+    head[1].setMipmap(mip);
+    // (a new mipmap has no levels until it is built)
+    readLevel = 0;
+}
+
 void ReadWriteHead::setLoopFlag(bool val) {
     loopFlag = val;
 }
@@ -196,6 +461,10 @@ void ReadWriteHead::setRecOnceFlag(bool val) {
     recOnceHead = -1;
 }
 
+bool ReadWriteHead::isStopped() {
+    return head[0].state() == Stopped && head[1].state() == Stopped && !queuedCrossfadeFlag;
+}
+
 bool ReadWriteHead::getRecOnceDone() {
   return recOnceDone;
 }
@@ -206,22 +475,11 @@ bool ReadWriteHead::getRecOnceActive() {
 
 void ReadWriteHead::setSampleRate(float sr_) {
     sr = sr_;
+    calcFadeInc();
     head[0].setSampleRate(sr);
     head[1].setSampleRate(sr);
 }
 
-sample_t ReadWriteHead::mixFade(sample_t x, sample_t y, float a, float b) {
-        return x * sinf(a * (float)M_PI_2) + y * sinf(b * (float) M_PI_2);
-}
-
-void ReadWriteHead::setRec(float x) {
-    rec = x;
-}
-
-void ReadWriteHead::setPre(float x) {
-    pre = x;
-}
-
 phase_t ReadWriteHead::getActivePhase() {
   return head[active].phase();
 }
@@ -244,6 +502,10 @@ void ReadWriteHead::setRecOffsetSamples(int d) {
     head[1].setRecOffsetSamples(d);
 }
 
+void ReadWriteHead::setInterpolation(InterpQuality q) {
+    interp = q;
+}
+
 void ReadWriteHead::stop() {
     head[0].setState(State::Stopped);
     head[1].setState(State::Stopped);
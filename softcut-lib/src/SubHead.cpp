@@ -3,6 +3,8 @@
 //
 
 #include <string.h>
+#include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include "softcut/Interpolate.h"
@@ -11,81 +13,178 @@
 
 using namespace softcut;
 
-void SubHead::init(FadeCurves *fc) {
+void SubHead::init(const FadeCurves *fc) {
     fadeCurves = fc;
-    phase_ = 0;
+    phase_ = Phase::fromFrames(0);
     fade_ = 0;
     trig_ = 0;
     state_ = Stopped;
-    resamp_.setPhase(0);
-    inc_dir_ = 1;
+    rate_ = 1.0;
+    inc_ = Phase::fromFrames(rate_);
     recOffset_ = -8;
+    wrIdx_ = 0;
+    // make sure the write index is placed relative to phase on the first written frame
+    cutFlag_ = true;
 }
 
-Action SubHead::updatePhase(phase_t start, phase_t end, bool loop) {
-    Action res = None;
-    trig_ = 0.f;
-    phase_t p;
-    switch(state_) {
-        case FadeIn:
-        case FadeOut:
-        case Playing:
-            p = phase_ + rate_;
-            if(active_) {
-                // FIXME: should refactor this a bit.
-                if (rate_ > 0.f) {
-                    if (p > end || p < start) {
-                        if (loop) {
-                            trig_ = 1.f;
-                            res = LoopPos;
-                        } else {
-                            state_ = FadeOut;
-                            res = Stop;
-                        }
-                    }
-                } else { // negative rate
-                    if (p > end || p < start) {
-                        if(loop) {
-                            trig_ = 1.f;
-                            res = LoopNeg;
-                        } else {
-                            state_ = FadeOut;
-                            res = Stop;
-                        }
-                    }
-                } // rate sign check
-            } // /active check
-            phase_ = p;
-            break;
-        case Stopped:
-        default:
-            ;; // nothing to do
-    }
-    return res;
-}
-
-void SubHead::updateFade(float inc) {
-    switch(state_) {
-        case FadeIn:
-            fade_ += inc;
-            if (fade_ > 1.f) {
-                fade_ = 1.f;
-                state_ = Playing;
+void SubHead::beginBlock() {
+    wrIdxBlock_ = wrIdx_;
+}
+
+void SubHead::followFrames(const SubHead &lead, int numFrames, bool moved) {
+    phase_ = lead.phase_;
+    fade_ = lead.fade_;
+    trig_ = lead.trig_;
+    state_ = lead.state_;
+    rate_ = lead.rate_;
+    inc_ = lead.inc_;
+    active_ = lead.active_;
+    cutFlag_ = false;
+    // write from where the leader's block began. (cuts move the index even while nothing
+    // is written, and the leader may have written these frames already)
+    wrIdxBlock_ = moved ? lead.wrIdxBlock_ : lead.wrIdx_;
+    wrIdx_ = wrIdxBlock_;
+    if (moved) {
+        std::copy(lead.phaseBuf_.begin(), lead.phaseBuf_.begin() + numFrames, phaseBuf_.begin());
+        std::copy(lead.fadeBuf_.begin(), lead.fadeBuf_.begin() + numFrames, fadeBuf_.begin());
+        std::copy(lead.stateBuf_.begin(), lead.stateBuf_.begin() + numFrames, stateBuf_.begin());
+        std::copy(lead.cutBuf_.begin(), lead.cutBuf_.begin() + numFrames, cutBuf_.begin());
+        std::copy(lead.writeBuf_.begin(), lead.writeBuf_.begin() + numFrames, writeBuf_.begin());
+    } else {
+        std::fill(phaseBuf_.begin(), phaseBuf_.begin() + numFrames, phase_);
+        std::fill(fadeBuf_.begin(), fadeBuf_.begin() + numFrames, fade_);
+        std::fill(stateBuf_.begin(), stateBuf_.begin() + numFrames, state_);
+        std::fill(cutBuf_.begin(), cutBuf_.begin() + numFrames, false);
+        std::fill(writeBuf_.begin(), writeBuf_.begin() + numFrames, true);
+    }
+}
+
+int SubHead::framesToEvent(headphase_t start, headphase_t end, float fadeInc, int limit) const {
+    if (state_ == Stopped) {
+        return limit;
+    }
+    // with a margin for rounding in the per-frame sums, over up to a block
+    float n = static_cast<float>(limit);
+    if ((state_ == FadeIn || state_ == FadeOut) && fadeInc > 0.f) {
+        const float tol = MaxBlockFrames * std::numeric_limits<float>::epsilon();
+        const float left = (state_ == FadeIn ? 1.f - fade_ : fade_) - tol;
+        n = std::min(n, left / fadeInc - 1.f);
+    }
+    // only the active subhead checks loop points
+    if (active_) {
+        const phase_t p = Phase::toFrames(phase_);
+        const phase_t r = Phase::toFrames(inc_);
+        const phase_t lo = Phase::toFrames(start);
+        const phase_t hi = Phase::toFrames(end);
+        if (p < lo || p > hi) {
+            return 0;
+        }
+        if (r != 0.0) {
+            const phase_t tol = MaxBlockFrames * std::numeric_limits<phase_t>::epsilon()
+                                * (std::fabs(p) + std::fabs(lo) + std::fabs(hi) + 1.0);
+            const phase_t left = (r > 0.0 ? hi - p : p - lo) - tol;
+            n = std::min(n, static_cast<float>(std::min(left / std::fabs(r), static_cast<phase_t>(limit))) - 1.f);
+        }
+    }
+    return n > 0.f ? static_cast<int>(n) : 0;
+}
+
+void SubHead::calcLevels(const float *pre, const float *rec, int numFrames) {
+    for (int i=0; i<numFrames; ++i) {
+        const float fade = fadeBuf_[i];
+        BOOST_ASSERT_MSG(fade >= 0.f && fade <= 1.f, "bad fade coefficient in calcLevels()");
+        preBuf_[i] = pre[i] + (1.f-pre[i]) * fadeCurves->getPreFadeValue(fade);
+        recBuf_[i] = rec[i] * fadeCurves->getRecFadeValue(fade);
+    }
+}
+
+bool SubHead::isUnitySpan(int numFrames, int &dir) const {
+    const headphase_t p0 = phaseBuf_[0];
+    if (!Phase::isWhole(p0)) {
+        return false;
+    }
+    dir = (numFrames > 1 && phaseBuf_[1] < p0) ? -1 : 1;
+    const headphase_t step = dir * Phase::OneFrame;
+    bool unity = true;
+    for (int i=1; i<numFrames; ++i) {
+        unity &= (phaseBuf_[i] == phaseBuf_[i-1] + step);
+    }
+    return unity;
+}
+
+template<class Interp>
+void SubHead::peekBlock(sample_t *out, int numFrames, int level) {
+    if (level > 0) {
+        interpolateFrames<Interp>(out, numFrames, mip_->getLevel(level), bufFrames_ >> level, level);
+        return;
+    }
+    // reading exactly on frames, interpolation returns the frame itself
+    int dir;
+    if (isUnitySpan(numFrames, dir)) {
+        const unsigned int idx = wrapBufIndex(Phase::index(phaseBuf_[0]));
+        if (dir > 0 && idx + numFrames <= bufFrames_) {
+            std::copy(buf_ + idx, buf_ + idx + numFrames, out);
+        } else {
+            for (int i=0; i<numFrames; ++i) {
+                out[i] = buf_[(idx + i*dir) & bufMask_];
             }
-            break;
-        case FadeOut:
-            fade_ -= inc;
-            if (fade_ < 0.f) {
-                fade_ = 0.f;
-                state_ = Stopped;
+        }
+        return;
+    }
+    interpolateFrames<Interp>(out, numFrames, buf_, bufFrames_, 0);
+}
+
+template<class Interp>
+void SubHead::interpolateFrames(sample_t *out, int numFrames,
+                                const sample_t *buf, unsigned int frames, int level) {
+    // one frame per lane
+    constexpr int taps = Interp::Taps;
+    // offset of the first tap from the frame before the phase
+    constexpr int first = 1 - taps / 2;
+    const unsigned int mask = frames - 1;
+    const int lastFrame = static_cast<int>(frames) - taps / 2 - 1;
+    int i = 0;
+    for (; i + LaneWidth <= numFrames; i += LaneWidth) {
+        int idx[LaneWidth];
+        lanes_t x = {};
+        bool inside = true;
+        for (int l=0; l<LaneWidth; ++l) {
+            // phases are in frames of the buffer; scale to frames of the level
+            const headphase_t phase = Phase::downscale(phaseBuf_[i+l], level);
+            idx[l] = Phase::index(phase);
+            x[l] = Phase::fraction(phase);
+            inside &= (idx[l] >= -first) & (idx[l] <= lastFrame);
+        }
+        // gather taps; away from the buffer ends, without wrapping
+        lanes_t y[taps] = {};
+        if (inside) {
+            for (int l=0; l<LaneWidth; ++l) {
+                const sample_t *p = buf + idx[l] + first;
+                for (int k=0; k<taps; ++k) {
+                    y[k][l] = p[k];
+                }
             }
-            break;
-        case Playing:
-        case Stopped:
-        default:;; // nothing to do
+        } else {
+            for (int l=0; l<LaneWidth; ++l) {
+                for (int k=0; k<taps; ++k) {
+                    y[k][l] = buf[(idx[l] + first + k + frames) & mask];
+                }
+            }
+        }
+        const lanes_t v = Interp::interpolate(x, y);
+        for (int l=0; l<LaneWidth; ++l) {
+            out[i+l] = v[l];
+        }
+    }
+    for (; i<numFrames; ++i) {
+        out[i] = peek<Interp>(buf, frames, Phase::downscale(phaseBuf_[i], level));
     }
 }
 
+template void SubHead::peekBlock<InterpLinear>(sample_t *out, int numFrames, int level);
+template void SubHead::peekBlock<InterpHermite>(sample_t *out, int numFrames, int level);
+template void SubHead::peekBlock<InterpSinc>(sample_t *out, int numFrames, int level);
+
 #if 0
 /// test: no resampling
 void Subhead::poke(float in, float pre, float rec, int numFades) {
@@ -94,57 +193,110 @@ void Subhead::poke(float in, float pre, float rec, int numFades) {
     *p += (in * rec);
 }
 #else
-void SubHead::poke(float in, float pre, float rec) {
-    // FIXME: since there's never really a reason to not push input, or to reset input ringbuf,
-    // it follows that all resamplers could share an input ringbuf
-    int nframes = resamp_.processFrame(in);
+void SubHead::beginWrite() {
+    // the write index is advanced here rather than in the position stage,
+    // since it depends on resampler output count.
+    // cuts performed during the position stage have already moved wrIdx_,
+    // so start again from where this block began.
+    wrIdx_ = wrIdxBlock_;
+    marking_ = (mip_ != nullptr) && mip_->isTracking();
+}
 
-    if(state_ == Stopped) {
-        return;
+void SubHead::endWrite() {
+    for (int i=0; i<numMarked_; ++i) {
+        mip_->markDirty(marked_[i]);
     }
+    numMarked_ = 0;
+}
 
-    BOOST_ASSERT_MSG(fade_ >= 0.f && fade_ <= 1.f, "bad fade coefficient in poke()");
-
-    preFade_ = pre + (1.f-pre) * fadeCurves->getPreFadeValue(fade_);
-    recFade_ = rec * fadeCurves->getRecFadeValue(fade_);
-
-    sample_t y; // write value
-    const sample_t* src = resamp_.output();
-
-    for(int i=0; i<nframes; ++i) {
-        y = src[i];
-
+void SubHead::pokeFrames(const sample_t *src, const int *count, const float *rate,
+                         int offset, int numFrames) {
+    unsigned int idx = wrIdx_;
+    for (int k=0; k<numFrames; ++k) {
+        const int i = offset + k;
+        // NB: resampler doesn't handle negative rates.
+        // instead we copy the resampler output backwards into the buffer when rate < 0.
+        const int dir = boost::math::sign(rate[i]);
+        if (cutBuf_[i]) {
+            idx = wrapBufIndex(Phase::index(phaseBuf_[i]) + (dir * recOffset_));
+        }
+        const int nframes = count[k];
+        if (!writeBuf_[i] || stateBuf_[i] == Stopped) {
+            src += nframes;
+            continue;
+        }
+        const float preFade = preBuf_[i];
+        const float recFade = recBuf_[i];
+        // frames written for one input frame are fewer than a chunk,
+        // so flagging both ends covers every chunk touched
+        if (marking_ && nframes > 0) {
+            markWrite(idx);
+            markWrite(wrapBufIndex(static_cast<int>(idx) + dir * (nframes - 1)));
+        }
+        for(int j=0; j<nframes; ++j) {
+            sample_t y = *src++;
 #if 1 // soft clipper
-        y = clip_.processSample(y);
+            y = clip_.processSample(y);
 #endif
 #if 0 // lowpass filter
-        lpf_.processSample(&y);
+            lpf_.processSample(&y);
 #endif
-        buf_[wrIdx_] *= preFade_;
-        buf_[wrIdx_] += y * recFade_;
-
-        wrIdx_ = wrapBufIndex(wrIdx_ + inc_dir_);
+            buf_[idx] *= preFade;
+            buf_[idx] += y * recFade;
+            idx = wrapBufIndex(idx + dir);
+        }
     }
+    wrIdx_ = idx;
 }
 #endif
 
-float SubHead::peek() {
-    return peek4();
+// same as pokeFrames(), for a block at constant unity rate, with one output frame per input frame
+void SubHead::pokeFramesUnity(const sample_t *src, int dir, int numFrames) {
+    unsigned int idx = wrIdx_;
+    for (int i=0; i<numFrames; ++i) {
+        if (cutBuf_[i]) {
+            idx = wrapBufIndex(Phase::index(phaseBuf_[i]) + (dir * recOffset_));
+        }
+        if (!writeBuf_[i] || stateBuf_[i] == Stopped) {
+            continue;
+        }
+        if (marking_) {
+            markWrite(idx);
+        }
+        const sample_t y = clip_.processSample(src[i]);
+        buf_[idx] *= preBuf_[i];
+        buf_[idx] += y * recBuf_[i];
+        idx = (idx + dir) & bufMask_;
+    }
+    wrIdx_ = idx;
 }
 
-float SubHead::peek4() {
-    int phase1 = static_cast<int>(phase_);
-    int phase0 = phase1 - 1;
-    int phase2 = phase1 + 1;
-    int phase3 = phase1 + 2;
-
-    float y0 = buf_[wrapBufIndex(phase0)];
-    float y1 = buf_[wrapBufIndex(phase1)];
-    float y3 = buf_[wrapBufIndex(phase3)];
-    float y2 = buf_[wrapBufIndex(phase2)];
+void SubHead::skipFrames(const int *count, const float *rate, int offset, int numFrames) {
+    unsigned int idx = wrIdx_;
+    for (int k=0; k<numFrames; ++k) {
+        const int i = offset + k;
+        const int dir = boost::math::sign(rate[i]);
+        if (cutBuf_[i]) {
+            idx = wrapBufIndex(Phase::index(phaseBuf_[i]) + (dir * recOffset_));
+        }
+        if (!writeBuf_[i] || stateBuf_[i] == Stopped) {
+            continue;
+        }
+        idx = wrapBufIndex(static_cast<int>(idx) + dir * count[k]);
+    }
+    wrIdx_ = idx;
+}
 
-    auto x = static_cast<float>(phase_ - (float)phase1);
-    return Interpolate::hermite<float>(x, y0, y1, y2, y3);
+template<class Interp>
+sample_t SubHead::peek(const sample_t *buf, unsigned int frames, headphase_t phase) {
+    constexpr int taps = Interp::Taps;
+    const int phase1 = Phase::index(phase);
+    float y[taps];
+    for (int k=0; k<taps; ++k) {
+        y[k] = buf[(phase1 + 1 - taps/2 + k + frames) & (frames - 1)];
+    }
+    auto x = Phase::fraction(phase);
+    return Interp::interpolate(x, y);
 }
 
 unsigned int SubHead::wrapBufIndex(int x) {
@@ -158,8 +310,10 @@ void SubHead::setSampleRate(float sr) {
 }
 
 void SubHead::setPhase(phase_t phase) {
-    phase_ = phase;
-    wrIdx_ = wrapBufIndex(static_cast<int>(phase_) + (inc_dir_ * recOffset_));
+    phase_ = Phase::fromFrames(phase);
+    const int dir = boost::math::sign(rate_);
+    wrIdx_ = wrapBufIndex(Phase::index(phase_) + (dir * recOffset_));
+    cutFlag_ = true;
 
     // NB: not resetting the resampler here:
     // - it's ok to keep history of input when changing positions.
@@ -175,15 +329,12 @@ void SubHead::setBuffer(float *buf, unsigned int frames) {
     BOOST_ASSERT_MSG((bufFrames_ != 0) && !(bufFrames_ & bufMask_), "buffer size is not 2^N");
 }
 
-void SubHead::setRate(rate_t rate) {
-    rate_ = rate;
-    inc_dir_ = boost::math::sign(rate);
-    // NB: resampler doesn't handle negative rates.
-    // instead we copy the resampler output backwards into the buffer when rate < 0.
-    resamp_.setRate(std::fabs(rate));
+void SubHead::setMipmap(Mipmap *mip) {
+    mip_ = mip;
+    marking_ = false;
+    numMarked_ = 0;
 }
 
-
 void SubHead::setState(State state) {
     state_ = state;
     if (state_ == Stopped) {
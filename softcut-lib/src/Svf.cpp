@@ -3,41 +3,309 @@
 //
 
 #include <math.h>
+#include <string.h>
 #include "softcut/Svf.h"
 
-Svf::Svf() = default;
+using softcut::lanes_t;
+
+namespace {
+    // tan(pi * w), for normalized frequency w in [0, 0.5), linearly interpolated.
+    // relative error is under 1e-4 up to w = 0.45; above that, g is large enough
+    // that the coefficients barely change.
+    struct TanTable {
+        static constexpr int Size = 1024;
+        float y[Size];
+
+        TanTable() {
+            for (int i = 0; i < Size; ++i) {
+                y[i] = static_cast<float>(tan(M_PI * 0.5 * i / Size));
+            }
+        }
+
+        float lookup(float w) const {
+            float x = w * (2 * Size);
+            x = (x < 0.f) ? 0.f : (x > Size - 1) ? Size - 1 : x;
+            int i = static_cast<int>(x);
+            i = (i > Size - 2) ? Size - 2 : i;
+            return y[i] + (x - i) * (y[i + 1] - y[i]);
+        }
+    };
+
+    const TanTable tanTable;
+
+    // (Svf storage isn't aligned for lanes)
+    inline lanes_t loadLanes(const float *p) {
+        lanes_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+}
+
+Svf::Svf() {
+    // defaults until set; a cutoff set before the sample rate is clamped against this rate
+    svf.sr = 48000.f;
+    svf.fc = 1000.f;
+    svf.rq = 1.f;
+    svf_calc_coeffs(&svf);
+    svf_init(&svf);
+}
 
 float Svf::getNextSample(float x) {
+    if (glideSamples > 0) {
+        svf.g1 += dg1;
+        svf.g2 += dg2;
+        svf.g3 += dg3;
+        svf.g4 += dg4;
+        --glideSamples;
+    }
     svf_update(&svf, x);
     return svf.lp * lpMix + svf.hp * hpMix + svf.bp * bpMix + svf.br * brMix;
 }
 
 void Svf::setSampleRate(float sr) {
+    glideSamples = 0;
     svf_set_sr(&svf, sr);
 }
 
 void Svf::setFc(float fc) {
+    glideSamples = 0;
     svf_set_fc(&svf, fc);
 }
 
 void Svf::setRq(float rq) {
+    glideSamples = 0;
     svf_set_rq(&svf, rq);
 }
 
+void Svf::glideFc(float fc, int samples) {
+    const float g1 = svf.g1;
+    const float g2 = svf.g2;
+    const float g3 = svf.g3;
+    const float g4 = svf.g4;
+    svf.fc = (fc > svf.sr / 2) ? svf.sr / 2 : fc;
+    svf.g = tanTable.lookup(svf.fc / svf.sr);
+    svf_calc_gains(&svf);
+    if (samples < 1) {
+        glideSamples = 0;
+        return;
+    }
+    const float k = 1.f / static_cast<float>(samples);
+    dg1 = (svf.g1 - g1) * k;
+    dg2 = (svf.g2 - g2) * k;
+    dg3 = (svf.g3 - g3) * k;
+    dg4 = (svf.g4 - g4) * k;
+    svf.g1 = g1;
+    svf.g2 = g2;
+    svf.g3 = g3;
+    svf.g4 = g4;
+    glideSamples = samples;
+}
+
+void Svf::finishGlide() {
+    // (step by step, to end where getNextSample() would)
+    for (; glideSamples > 0; --glideSamples) {
+        svf.g1 += dg1;
+        svf.g2 += dg2;
+        svf.g3 += dg3;
+        svf.g4 += dg4;
+    }
+}
+
 void Svf::setLpMix(float mix) {
     lpMix = mix;
+    updateOutput();
 }
 
 void Svf::setHpMix(float mix) {
     hpMix = mix;
+    updateOutput();
 }
 
 void Svf::setBpMix(float mix) {
     bpMix = mix;
+    updateOutput();
 }
 
 void Svf::setBrMix(float mix) {
-        brMix = mix;
+    brMix = mix;
+    updateOutput();
+}
+
+void Svf::updateOutput() {
+    const int n = (lpMix != 0.f) + (hpMix != 0.f) + (bpMix != 0.f) + (brMix != 0.f);
+    if (n == 0) {
+        if (output != Output::None) {
+            svf_clear_state(&svf);
+        }
+        output = Output::None;
+    } else if (n > 1) {
+        output = Output::Mix;
+    } else {
+        output = (lpMix != 0.f) ? Output::Lp : (hpMix != 0.f) ? Output::Hp
+                 : (bpMix != 0.f) ? Output::Bp : Output::Br;
+    }
+}
+
+void Svf::processFrames(const float *in, float *out, int n, float dry) {
+    if (output == Output::None) {
+        finishGlide();
+        for (int i = 0; i < n; ++i) {
+            out[i] = in[i] * dry;
+        }
+        return;
+    }
+    // whole blocks at once, unless the coefficients are changing from sample to sample
+    if (glideSamples == 0) {
+        const int k = n - n % BlockSamples;
+        processBlocks(in, out, k, dry);
+        in += k;
+        out += k;
+        n -= k;
+    }
+    switch (output) {
+        case Output::None:
+            break;
+        case Output::Lp:
+            processFrames<Output::Lp>(in, out, n, dry);
+            break;
+        case Output::Hp:
+            processFrames<Output::Hp>(in, out, n, dry);
+            break;
+        case Output::Bp:
+            processFrames<Output::Bp>(in, out, n, dry);
+            break;
+        case Output::Br:
+            processFrames<Output::Br>(in, out, n, dry);
+            break;
+        case Output::Mix:
+            processFrames<Output::Mix>(in, out, n, dry);
+            break;
+    }
+}
+
+template<Svf::Output O>
+void Svf::processFrames(const float *in, float *out, int n, float dry) {
+    // as svf_update(), with everything in locals
+    // (members could otherwise alias the output, and be reloaded for each sample)
+    float g1 = svf.g1, g2 = svf.g2, g3 = svf.g3, g4 = svf.g4;
+    const float d1 = dg1, d2 = dg2, d3 = dg3, d4 = dg4;
+    const float rq = svf.rq;
+    const float lp = lpMix, hp = hpMix, bp = bpMix, br = brMix;
+    float v0z = svf.v0z, v1 = svf.v1, v2 = svf.v2;
+    int glide = glideSamples;
+    for (int i = 0; i < n; ++i) {
+        if (glide > 0) {
+            g1 += d1;
+            g2 += d2;
+            g3 += d3;
+            g4 += d4;
+            --glide;
+        }
+        const float x = in[i];
+        const float v1z = v1;
+        const float v2z = v2;
+        const float v3 = x + v0z - 2.f * v2z;
+        v1 += g1 * v3 - g2 * v1z;
+        v2 += g3 * v3 + g4 * v1z;
+        v0z = x;
+        float y;
+        switch (O) {
+            case Output::Lp:
+                y = v2 * lp;
+                break;
+            case Output::Hp:
+                y = (x - rq * v1 - v2) * hp;
+                break;
+            case Output::Bp:
+                y = v1 * bp;
+                break;
+            case Output::Br:
+                y = (x - rq * v1) * br;
+                break;
+            default:
+                y = v2 * lp + (x - rq * v1 - v2) * hp + v1 * bp + (x - rq * v1) * br;
+                break;
+        }
+        out[i] = y + x * dry;
+    }
+    svf.g1 = g1;
+    svf.g2 = g2;
+    svf.g3 = g3;
+    svf.g4 = g4;
+    glideSamples = glide;
+    svf.v0z = v0z;
+    svf.v1 = v1;
+    svf.v2 = v2;
+}
+
+void Svf::processBlocks(const float *in, float *out, int n, float dry) {
+    if (n < BlockSamples) {
+        return;
+    }
+    if (svf.g1 != blockG[0] || svf.g2 != blockG[1] || svf.g3 != blockG[2] || svf.g4 != blockG[3]) {
+        calcBlockCoeffs();
+    }
+    const lanes_t a11 = loadLanes(blockA11);
+    const lanes_t a12 = loadLanes(blockA12);
+    const lanes_t a21 = loadLanes(blockA21);
+    const lanes_t a22 = loadLanes(blockA22);
+    // all outputs are (mix of v1, v2 and input) = c1 v1 + c2 v2 + d x
+    const float c1 = bpMix - svf.rq * (hpMix + brMix);
+    const float c2 = lpMix - hpMix;
+    const float d = hpMix + brMix + dry;
+    float v0z = svf.v0z, v1 = svf.v1, v2 = svf.v2;
+    for (int i = 0; i < n; i += BlockSamples) {
+        const float *x = in + i;
+        lanes_t s1 = a11 * v1 + a12 * v2;
+        lanes_t s2 = a21 * v1 + a22 * v2;
+        for (int j = 0; j < BlockSamples; ++j) {
+            const float u = x[j] + (j > 0 ? x[j - 1] : v0z);
+            s1 += loadLanes(blockH1 + BlockSamples - 1 - j) * u;
+            s2 += loadLanes(blockH2 + BlockSamples - 1 - j) * u;
+        }
+        const lanes_t y = s1 * c1 + s2 * c2 + loadLanes(x) * d;
+        memcpy(out + i, &y, sizeof(y));
+        v0z = x[BlockSamples - 1];
+        v1 = s1[BlockSamples - 1];
+        v2 = s2[BlockSamples - 1];
+    }
+    svf.v0z = v0z;
+    svf.v1 = v1;
+    svf.v2 = v2;
+}
+
+void Svf::calcBlockCoeffs() {
+    // (in double, since the powers of A compound rounding)
+    const double a11 = 1.0 - svf.g2, a12 = -2.0 * svf.g1;
+    const double a21 = svf.g4, a22 = 1.0 - 2.0 * svf.g3;
+    // A^(k+1), and A^k B
+    double p11 = a11, p12 = a12, p21 = a21, p22 = a22;
+    double h1 = svf.g1, h2 = svf.g3;
+    for (int k = 0; k < BlockSamples; ++k) {
+        blockA11[k] = static_cast<float>(p11);
+        blockA12[k] = static_cast<float>(p12);
+        blockA21[k] = static_cast<float>(p21);
+        blockA22[k] = static_cast<float>(p22);
+        blockH1[BlockSamples - 1 + k] = static_cast<float>(h1);
+        blockH2[BlockSamples - 1 + k] = static_cast<float>(h2);
+        const double q11 = a11 * p11 + a12 * p21, q12 = a11 * p12 + a12 * p22;
+        const double q21 = a21 * p11 + a22 * p21, q22 = a21 * p12 + a22 * p22;
+        p11 = q11;
+        p12 = q12;
+        p21 = q21;
+        p22 = q22;
+        const double k1 = a11 * h1 + a12 * h2, k2 = a21 * h1 + a22 * h2;
+        h1 = k1;
+        h2 = k2;
+    }
+    for (int k = 0; k < BlockSamples - 1; ++k) {
+        blockH1[k] = 0.f;
+        blockH2[k] = 0.f;
+    }
+    blockG[0] = svf.g1;
+    blockG[1] = svf.g2;
+    blockG[2] = svf.g3;
+    blockG[3] = svf.g4;
 }
 
 /////////////////
@@ -45,6 +313,10 @@ void Svf::setBrMix(float mix) {
 
 void Svf::svf_calc_coeffs(t_svf* svf) {
     svf->g = static_cast<float>(tan(M_PI * svf->fc / svf->sr));
+    svf_calc_gains(svf);
+}
+
+void Svf::svf_calc_gains(t_svf* svf) {
     svf->g1 = svf->g / (1.f + svf->g * (svf->g + svf->rq));
     svf->g2 = 2.f * (svf->g + svf->rq) * svf->g1;
     svf->g3 = svf->g * svf->g1;
@@ -94,4 +366,31 @@ void Svf::svf_update(t_svf* svf, float in) {
 
 float Svf::getFc() {
     return svf.fc;
+}
+
+bool Svf::isDecayed() const {
+    // about -160dB
+    static constexpr float eps = 1e-8f;
+    return fabsf(svf.v0z) < eps && fabsf(svf.v1) < eps && fabsf(svf.v2) < eps;
+}
+
+void Svf::clear() {
+    svf_clear_state(&svf);
+}
+
+Svf::Coeffs Svf::getCoeffs() const {
+    if (glideSamples > 0) {
+        return Coeffs { svf.g1, svf.g2, svf.g3, svf.g4, svf.rq, lpMix, hpMix, bpMix, brMix, dg1, dg2, dg3, dg4 };
+    }
+    return Coeffs { svf.g1, svf.g2, svf.g3, svf.g4, svf.rq, lpMix, hpMix, bpMix, brMix, 0.f, 0.f, 0.f, 0.f };
+}
+
+Svf::State Svf::getState() const {
+    return State { svf.v0z, svf.v1, svf.v2 };
+}
+
+void Svf::setState(const State &state) {
+    svf.v0z = state.v0z;
+    svf.v1 = state.v1;
+    svf.v2 = state.v2;
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+//
+// bank of state variable filters (see SvfBank.h)
+//
+
+#include "softcut/SvfBank.h"
+
+using namespace softcut;
+
+SvfBank::SvfBank(int numFilters) :
+        bank(), groups((numFilters + LaneWidth - 1) / LaneWidth), output(Svf::Output::None) {}
+
+void SvfBank::load(int i, const Svf &svf, float dryLevel) {
+    loadCoeffs(i, svf);
+    Group &f = bank[i / LaneWidth];
+    const int l = i % LaneWidth;
+    const Svf::State s = svf.getState();
+    f.v0z[l] = s.v0z;
+    f.v1[l] = s.v1;
+    f.v2[l] = s.v2;
+    f.dry[l] = dryLevel;
+    output = (i == 0 || svf.getOutput() == output) ? svf.getOutput() : Svf::Output::Mix;
+}
+
+bool SvfBank::loadCoeffs(int i, const Svf &svf) {
+    Group &f = bank[i / LaneWidth];
+    const int l = i % LaneWidth;
+    const Svf::Coeffs c = svf.getCoeffs();
+    f.g1[l] = c.g1;
+    f.g2[l] = c.g2;
+    f.g3[l] = c.g3;
+    f.g4[l] = c.g4;
+    f.rq[l] = c.rq;
+    f.lpMix[l] = c.lpMix;
+    f.hpMix[l] = c.hpMix;
+    f.bpMix[l] = c.bpMix;
+    f.brMix[l] = c.brMix;
+    f.dg1[l] = c.dg1;
+    f.dg2[l] = c.dg2;
+    f.dg3[l] = c.dg3;
+    f.dg4[l] = c.dg4;
+    return c.dg1 != 0.f || c.dg2 != 0.f || c.dg3 != 0.f || c.dg4 != 0.f;
+}
+
+void SvfBank::store(int i, Svf &svf) const {
+    if (svf.getOutput() == Svf::Output::None) {
+        return;
+    }
+    const Group &f = bank[i / LaneWidth];
+    const int l = i % LaneWidth;
+    svf.setState(Svf::State { f.v0z[l], f.v1[l], f.v2[l] });
+}
@@ -0,0 +1,95 @@
+//
+// per-sample head state tracing (see Trace.h)
+//
+
+#include "softcut/Trace.h"
+
+#if SOFTCUT_TRACE
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+using namespace softcut;
+
+TraceRing::TraceRing() : frames_(numFrames), writeIdx_(0), readIdx_(0), dropped_(0),
+                         droppedReported_(0) {
+    static std::atomic<int> count(0);
+    // raw float frames, in the layout of TraceFrame
+    const std::string path = "softcut_trace_" + std::to_string(count++) + ".raw";
+    file_ = fopen(path.c_str(), "wb");
+    TraceWriter::instance().add(this);
+}
+
+TraceRing::~TraceRing() {
+    TraceWriter::instance().remove(this);
+    drain();
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+bool TraceRing::drain() {
+    const unsigned int r = readIdx_.load(std::memory_order_relaxed);
+    const unsigned int w = writeIdx_.load(std::memory_order_acquire);
+    if (w == r) {
+        return false;
+    }
+    if (file_ != nullptr) {
+        // contiguous run up to the end of storage, then the wrapped remainder
+        const unsigned int i = r & frameMask;
+        const unsigned int n = w - r;
+        const unsigned int n1 = std::min(n, static_cast<unsigned int>(numFrames) - i);
+        fwrite(&frames_[i], sizeof(TraceFrame), n1, file_);
+        fwrite(&frames_[0], sizeof(TraceFrame), n - n1, file_);
+    }
+    readIdx_.store(w, std::memory_order_release);
+
+    const unsigned int dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != droppedReported_) {
+        fprintf(stderr, "softcut trace: dropped %u frames\n", dropped - droppedReported_);
+        droppedReported_ = dropped;
+    }
+    return true;
+}
+
+TraceWriter &TraceWriter::instance() {
+    static TraceWriter writer;
+    return writer;
+}
+
+TraceWriter::TraceWriter() : quit_(false) {
+    thread_ = std::thread([this] { run(); });
+}
+
+TraceWriter::~TraceWriter() {
+    quit_ = true;
+    thread_.join();
+}
+
+void TraceWriter::add(TraceRing *ring) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.push_back(ring);
+}
+
+void TraceWriter::remove(TraceRing *ring) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.erase(std::remove(rings_.begin(), rings_.end(), ring), rings_.end());
+}
+
+void TraceWriter::run() {
+    while (!quit_) {
+        bool busy = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto ring : rings_) {
+                busy |= ring->drain();
+            }
+        }
+        if (!busy) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+#endif // SOFTCUT_TRACE
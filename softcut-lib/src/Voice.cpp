@@ -2,7 +2,7 @@
 // Created by ezra on 11/3/18.
 //
 
-#include <functional>
+#include <algorithm>
 
 #include "softcut/Voice.h"
 #include "softcut/Resampler.h"
@@ -10,6 +10,10 @@
 using namespace softcut;
 
 Voice::Voice() :
+buf(nullptr),
+bufFrames(0),
+sampleRate(48000),
+fadeReader(FadeCurveRegistry::instance().addReader()),
 rateRamp(48000, 0.1),
 preRamp(48000, 0.1),
 recRamp(48000, 0.1)
@@ -18,8 +22,11 @@ recRamp(48000, 0.1)
     reset();
 }
 
+Voice::~Voice() {
+    FadeCurveRegistry::instance().removeReader(fadeReader);
+}
+
 void Voice::reset() {
-    fadeCurves.init();
     svfPre.setLpMix(1.0);
     svfPre.setHpMix(0.0);
     svfPre.setBpMix(0.0);
@@ -50,47 +57,42 @@ void Voice::reset() {
     recFlag = false;
     playFlag = false;
 
-    sch.init(&fadeCurves);
+    leader = nullptr;
+    leading = false;
+    duckRef = nullptr;
+    duckPublish = false;
+    duckLevel = 1.f;
+
+    sch.init(FadeCurveRegistry::instance().current());
 }
 
-void Voice:: processBlockMono(const float *in, float *out, int numFrames) {
-    std::function<void(sample_t, sample_t*)> sampleFunc;
-    if(playFlag) {
-        if(recFlag) {
-            sampleFunc = [this](float in, float* out) {
-                this->sch.processSample(in, out);
-            };
-        } else {
-            sampleFunc = [this](float in, float* out) {
-                this->sch.processSampleNoWrite(in, out);
-            };
-        }
+void Voice::processBlockMono(const float *in, float *out, int numFrames) {
+    if (isIdle()) {
+        processIdle(out, numFrames);
     } else {
-        if(recFlag) {
-            sampleFunc = [this](float in, float* out) {
-                this->sch.processSampleNoRead(in, out);
-            };
-        } else {
-            // FIXME? do nothing, i guess?
-            sampleFunc = [](float in, float* out) {
-                (void)in;
-                (void)out;
-            };
+        while (numFrames > 0) {
+            const int n = std::min(numFrames, static_cast<int>(MaxBlockFrames));
+            readFrames(n);
+            duckFrames(n);
+            filterFrames(in, out, n);
+            writeFrames(n);
+            in += n;
+            out += n;
+            numFrames -= n;
         }
     }
+    endBlock();
+}
 
-    float x, y;
-    for(int i=0; i<numFrames; ++i) {
-        x = svfPre.getNextSample(in[i]) + in[i]*svfPreDryLevel;
-        sch.setRate(rateRamp.update());
-        sch.setPre(preRamp.update());
-        sch.setRec(recRamp.update());
-        sampleFunc(x, &y);
-	    out[i] = svfPost.getNextSample(y) + y*svfPostDryLevel;
-        updateQuantPhase();
-    }
+bool Voice::isIdle() {
+    // idle: nothing to read or write, and the output filter has rung out
+    ReadWriteHead &head = (leader != nullptr) ? leader->sch : sch;
+    return (!(playFlag || recFlag) || head.isStopped()) && svfPost.isDecayed();
+}
 
-    
+void Voice::endBlock() {
+    FadeCurveRegistry::instance().endRead(fadeReader);
+    updateQuantPhase();
     rawPhase.store(sch.getActivePhase(), std::memory_order_relaxed);
 
     if(recFlag) {
@@ -103,6 +105,165 @@ void Voice:: processBlockMono(const float *in, float *out, int numFrames) {
     }
 }
 
+void Voice::readFrames(int numFrames) {
+    // pick up newly published fade curves, held until endBlock()
+    sch.setFadeCurves(FadeCurveRegistry::instance().beginRead(fadeReader));
+    framesRead = playFlag;
+    framesWrite = recFlag;
+    if (framesRead) {
+        if (framesWrite) {
+            readFrames<true, true>(numFrames);
+        } else {
+            readFrames<true, false>(numFrames);
+        }
+    } else {
+        if (framesWrite) {
+            readFrames<false, true>(numFrames);
+        } else {
+            readFrames<false, false>(numFrames);
+        }
+    }
+}
+
+void Voice::writeFrames(int numFrames) {
+    if (framesRead) {
+        if (framesWrite) {
+            writeFrames<true, true>(numFrames);
+        } else {
+            writeFrames<true, false>(numFrames);
+        }
+    } else {
+        if (framesWrite) {
+            writeFrames<false, true>(numFrames);
+        } else {
+            writeFrames<false, false>(numFrames);
+        }
+    }
+}
+
+template<bool Read, bool Write>
+void Voice::readFrames(int numFrames) {
+    // parameter ramps
+    preConst = updateRamp(preRamp, preBuf, numFrames);
+    recConst = updateRamp(recRamp, recBuf, numFrames);
+
+    // head positions, fades and states
+    if (leader != nullptr) {
+        followLeader(numFrames);
+    } else {
+        updateRamp(rateRamp, rateBuf, numFrames);
+        if (Read || Write) {
+            if (Write || leading) {
+                sch.updatePositions<true>(rateBuf.data(), numFrames);
+                ++headSerial;
+            } else {
+                sch.updatePositions<false>(rateBuf.data(), numFrames);
+            }
+        } else {
+            // FIXME? do nothing, i guess? (but keep the rate current)
+            sch.setRate(rateBuf[numFrames-1]);
+        }
+    }
+
+    if (Write && duckPublish) {
+        sch.getWritePositions(rateBuf.data(), writePosBuf.data(), numFrames);
+        ++writePosSerial;
+    }
+
+    // read and mix
+    if (Read) {
+        sch.peekBlock(outBuf.data(), numFrames);
+    } else {
+        std::fill(outBuf.begin(), outBuf.begin() + numFrames, 0.f);
+    }
+}
+
+void Voice::followLeader(int numFrames) {
+    // the leader has already processed these frames if its serial moved on;
+    // otherwise its head is standing still
+    const bool moved = leader->headSerial != followSerial;
+    followSerial = leader->headSerial;
+    // if following stops, the rate carries on from here
+    rateRamp = leader->rateRamp;
+    if (moved) {
+        std::copy(leader->rateBuf.begin(), leader->rateBuf.begin() + numFrames, rateBuf.begin());
+    } else {
+        std::fill(rateBuf.begin(), rateBuf.begin() + numFrames, static_cast<float>(leader->sch.getRate()));
+    }
+    sch.followPositions(leader->sch, numFrames, moved);
+}
+
+void Voice::duckFrames(int numFrames) {
+    if (duckRef == nullptr) {
+        return;
+    }
+    // duck only against positions written in these frames
+    const bool written = duckRef->writePosSerial != duckSerial;
+    duckSerial = duckRef->writePosSerial;
+    if (framesRead && written) {
+        sch.calcDuck(duckRef->writePosBuf.data(), duckWindow, duckBuf.data(), numFrames);
+    } else {
+        std::fill(duckBuf.begin(), duckBuf.begin() + numFrames, 1.f);
+    }
+    // smoothing covers jumps in position, and the reference starting or stopping
+    for (int i=0; i<numFrames; ++i) {
+        const float y = smooth1pole(duckBuf[i], duckLevel, duckPole);
+        // (rounding can stall just short of the target, e.g. of 1 once the reference moves away)
+        duckLevel = (y == duckLevel) ? duckBuf[i] : y;
+        outBuf[i] *= duckLevel;
+    }
+}
+
+void Voice::filterFrames(const float *in, float *out, int numFrames) {
+    // (each filter runs only the outputs it mixes, and not at all if none; see Svf::getOutput())
+    for (int i=0; i<numFrames; i+=svfTrackFrames) {
+        const int n = std::min(static_cast<int>(svfTrackFrames), numFrames - i);
+        trackPreSvfFc(i, n);
+        svfPre.processFrames(in + i, inBuf.data() + i, n, svfPreDryLevel);
+    }
+    svfPost.processFrames(outBuf.data(), out, numFrames, svfPostDryLevel);
+}
+
+template<bool Read, bool Write>
+void Voice::writeFrames(int numFrames) {
+    bool written = false;
+    if (Write) {
+        // fades only ever raise pre level towards 1 and scale rec level,
+        // so with pre=1 and rec=0 for the whole block the buffer is left as it is
+        if (preConst && recConst && preBuf[0] == 1.f && recBuf[0] == 0.f) {
+            sch.skipBlock(inBuf.data(), rateBuf.data(), numFrames);
+        } else {
+            sch.updateLevels(preBuf.data(), recBuf.data(), numFrames);
+            sch.pokeBlock(inBuf.data(), rateBuf.data(), numFrames);
+            written = true;
+        }
+    }
+
+    if (TraceEnabled && (Read || Write)) {
+        sch.traceBlock(numFrames, written);
+    }
+}
+
+void Voice::processIdle(float *out, int numFrames) {
+    // no need to ramp parameters that nobody hears
+    rateRamp.reset(rateRamp.getTarget());
+    preRamp.reset(preRamp.getTarget());
+    recRamp.reset(recRamp.getTarget());
+    sch.setRate(rateRamp.getValue());
+    // filters restart from rest
+    svfPre.clear();
+    svfPost.clear();
+    std::fill(out, out + numFrames, 0.f);
+}
+
+bool Voice::updateRamp(LogRamp &ramp, std::array<float, MaxBlockFrames> &buf, int numFrames) {
+    if (ramp.updateBlock(buf.data(), numFrames)) {
+        std::fill(buf.begin(), buf.begin() + numFrames, ramp.getValue());
+        return true;
+    }
+    return false;
+}
+
 void Voice::setSampleRate(float hz) {
     sampleRate = hz;
     rateRamp.setSampleRate(hz);
@@ -111,11 +272,13 @@ void Voice::setSampleRate(float hz) {
     sch.setSampleRate(hz);
     svfPre.setSampleRate(hz);
     svfPost.setSampleRate(hz);
+    setDuckWindow(duckWindowSec);
+    duckPole = tau2pole(duckSlewTime, hz);
 }
 
-void Voice::setRate(float rate) {    
+void Voice::setRate(float rate) {
+    // (the input filter follows the ramped rate; see trackPreSvfFc())
     rateRamp.setTarget(rate);
-    updatePreSvfFc();
 }
 
 void Voice::setLoopStart(float sec) {
@@ -134,6 +297,35 @@ void Voice::cutToPos(float sec) {
     sch.cutToPos(sec);
 }
 
+void Voice::setFollow(Voice *lead) {
+    leader = lead;
+    if (lead != nullptr) {
+        followSerial = lead->headSerial;
+    }
+}
+
+void Voice::setLeading(bool val) {
+    leading = val;
+}
+
+void Voice::setDuck(Voice *ref) {
+    duckRef = ref;
+    if (ref != nullptr) {
+        duckSerial = ref->writePosSerial;
+    } else {
+        duckLevel = 1.f;
+    }
+}
+
+void Voice::setDuckWindow(float sec) {
+    duckWindowSec = sec;
+    duckWindow = sec * sampleRate;
+}
+
+void Voice::setDuckPublish(bool val) {
+    duckPublish = val;
+}
+
 void Voice::setRecLevel(float amp) {
     recRamp.setTarget(amp);
 }
@@ -212,10 +404,21 @@ void Voice::setPreFilterFcMod(float x) {
     svfPreFcMod = x;
 }
 
+float Voice::preSvfFc(float rate) const {
+    const float fcMod = std::min(svfPreFcBase, svfPreFcBase * std::fabs(rate));
+    return svfPreFcBase + svfPreFcMod * (fcMod - svfPreFcBase);
+}
+
 void Voice::updatePreSvfFc() {
-    float fcMod = std::min(svfPreFcBase, svfPreFcBase * std::fabs(static_cast<float>(sch.getRate())));
-    fcMod = svfPreFcBase + svfPreFcMod * (fcMod - svfPreFcBase);
-    svfPre.setFc(fcMod);
+    svfPre.setFc(preSvfFc(static_cast<float>(sch.getRate())));
+}
+
+void Voice::trackPreSvfFc(int i, int n) {
+    // aim for the rate at the end of the frames, and arrive there with it
+    const float fc = std::min(preSvfFc(rateBuf[i + n - 1]), sampleRate / 2);
+    if (fc != svfPre.getFc()) {
+        svfPre.glideFc(fc, n);
+    }
 }
 
 // output filter
@@ -256,9 +459,27 @@ void Voice::setRecOnceFlag(bool val) {
 }
 
 void Voice::setBuffer(float *b, unsigned int nf) {
+    const bool changed = (b != buf || static_cast<int>(nf) != bufFrames);
     buf = b;
     bufFrames = nf;
     sch.setBuffer(buf, bufFrames);
+    // (the mipmap of the old buffer is released; the voice no longer reads it)
+    if (changed) {
+        setMipmap(nullptr);
+    }
+}
+
+void Voice::setMipmap(MipmapWorker *mips) {
+    // (attach first, so a mipmap kept for the same buffer isn't freed in between)
+    Mipmap *old = sch.getMipmap();
+    sch.setMipmap(mips != nullptr ? mips->attach(buf, bufFrames) : nullptr);
+    if (old != nullptr) {
+        old->release();
+    }
+}
+
+bool Voice::sharesBuffer(const Voice &other) const {
+    return buf < other.buf + other.bufFrames && other.buf < buf + bufFrames;
 }
 
 void Voice::setRecOffset(float d) {
@@ -274,6 +495,10 @@ void Voice::setRateSlewTime(float d) {
     rateRamp.setTime(d);
 }
 
+void Voice::setInterpolation(InterpQuality q) {
+    sch.setInterpolation(q);
+}
+
 void Voice::setPhaseQuant(float x) {
     phaseQuant = x;
 }
@@ -0,0 +1,110 @@
+//
+// processing stages run across several voices at once (see VoiceLanes.h)
+//
+
+#include <algorithm>
+
+#include "softcut/SvfBank.h"
+#include "softcut/Voice.h"
+#include "softcut/VoiceLanes.h"
+
+using namespace softcut;
+
+namespace {
+    // run a bank of filters over frames [i0, i0+n)
+    //! @param in, out: signals for each filter
+    template<bool Glide, Svf::Output O>
+    void processFrames(SvfBank &bank, const float *const *in, float *const *out,
+                       int numFilters, int i0, int n) {
+        for (int i = i0; i < i0 + n; ++i) {
+            // (groups of filters are independent, so their recursions overlap)
+            for (int g = 0; g < bank.numGroups(); ++g) {
+                const int k0 = g * LaneWidth;
+                const int numLanes = std::min(LaneWidth, numFilters - k0);
+                lanes_t x = {};
+                for (int l = 0; l < numLanes; ++l) {
+                    x[l] = in[k0 + l][i];
+                }
+                const lanes_t y = bank.process<Glide, O>(g, x);
+                for (int l = 0; l < numLanes; ++l) {
+                    out[k0 + l][i] = y[l];
+                }
+            }
+        }
+    }
+
+    // as above, with the kernel for the bank's outputs
+    template<bool Glide>
+    void processFrames(SvfBank &bank, const float *const *in, float *const *out,
+                       int numFilters, int i0, int n) {
+        switch (bank.getOutput()) {
+            case Svf::Output::None:
+                processFrames<Glide, Svf::Output::None>(bank, in, out, numFilters, i0, n);
+                break;
+            case Svf::Output::Lp:
+                processFrames<Glide, Svf::Output::Lp>(bank, in, out, numFilters, i0, n);
+                break;
+            case Svf::Output::Hp:
+                processFrames<Glide, Svf::Output::Hp>(bank, in, out, numFilters, i0, n);
+                break;
+            case Svf::Output::Bp:
+                processFrames<Glide, Svf::Output::Bp>(bank, in, out, numFilters, i0, n);
+                break;
+            case Svf::Output::Br:
+                processFrames<Glide, Svf::Output::Br>(bank, in, out, numFilters, i0, n);
+                break;
+            case Svf::Output::Mix:
+                processFrames<Glide, Svf::Output::Mix>(bank, in, out, numFilters, i0, n);
+                break;
+        }
+    }
+}
+
+void VoiceLanes::filterFrames(Voice *const *voices, const float *const *in, float *const *out,
+                              int numVoices, int numFrames, bool lanes) {
+    if (!lanes) {
+        for (int v = 0; v < numVoices; ++v) {
+            voices[v]->filterFrames(in[v], out[v], numFrames);
+        }
+        return;
+    }
+    for (int v0 = 0; v0 < numVoices; v0 += SvfBank::MaxFilters) {
+        const int numFilters = std::min(static_cast<int>(SvfBank::MaxFilters), numVoices - v0);
+        Voice *const *vf = voices + v0;
+        const float *const *inf = in + v0;
+        float *const *outf = out + v0;
+
+        SvfBank pre(numFilters);
+        SvfBank post(numFilters);
+        float *preOut[SvfBank::MaxFilters];
+        const float *postIn[SvfBank::MaxFilters];
+        for (int k = 0; k < numFilters; ++k) {
+            pre.load(k, vf[k]->svfPre, vf[k]->svfPreDryLevel);
+            post.load(k, vf[k]->svfPost, vf[k]->svfPostDryLevel);
+            preOut[k] = vf[k]->inBuf.data();
+            postIn[k] = vf[k]->outBuf.data();
+        }
+
+        for (int i = 0; i < numFrames; i += Voice::svfTrackFrames) {
+            const int n = std::min(static_cast<int>(Voice::svfTrackFrames), numFrames - i);
+            // input filters follow the rate, as in Voice::filterFrames()
+            bool glide = false;
+            for (int k = 0; k < numFilters; ++k) {
+                vf[k]->trackPreSvfFc(i, n);
+                glide |= pre.loadCoeffs(k, vf[k]->svfPre);
+                vf[k]->svfPre.finishGlide();
+            }
+            if (glide) {
+                processFrames<true>(pre, inf, preOut, numFilters, i, n);
+            } else {
+                processFrames<false>(pre, inf, preOut, numFilters, i, n);
+            }
+        }
+        processFrames<false>(post, postIn, outf, numFilters, 0, numFrames);
+
+        for (int k = 0; k < numFilters; ++k) {
+            pre.store(k, vf[k]->svfPre);
+            post.store(k, vf[k]->svfPost);
+        }
+    }
+}
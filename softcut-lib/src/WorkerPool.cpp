@@ -0,0 +1,180 @@
+//
+// small pool of worker threads (see WorkerPool.h)
+//
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "softcut/WorkerPool.h"
+
+using namespace softcut;
+
+namespace {
+    // counting semaphore; posting does not take a lock
+    class Semaphore {
+    public:
+#ifdef __APPLE__
+        Semaphore() : sem(dispatch_semaphore_create(0)) {}
+        ~Semaphore() { dispatch_release(sem); }
+        void post() { dispatch_semaphore_signal(sem); }
+        void wait() { dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER); }
+    private:
+        dispatch_semaphore_t sem;
+#else
+        Semaphore() { sem_init(&sem, 0, 0); }
+        ~Semaphore() { sem_destroy(&sem); }
+        void post() { sem_post(&sem); }
+        void wait() { while (sem_wait(&sem) != 0) {} }
+    private:
+        sem_t sem;
+#endif
+    };
+
+    // polls of the generation counter before parking
+    static constexpr int spinCount = 20000;
+
+    // WorkerPool::claim: generation in the high 32 bits, then number of tasks, then next task
+    inline uint64_t packClaim(unsigned int generation, int numTasks) {
+        return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(numTasks) << 16);
+    }
+}
+
+struct WorkerPool::Worker {
+    std::thread thread;
+    Semaphore wake;
+    // set while the worker is (about to be) waiting on its semaphore.
+    // whoever clears it is responsible for the wakeup.
+    std::atomic<bool> parked{false};
+};
+
+WorkerPool::WorkerPool(int numWorkers, bool pinThreads) :
+        quit(false), generation(0), claim(0), remaining(0),
+        fn(nullptr), context(nullptr), schedMatched(false), parallel(true) {
+    const unsigned int numCores = std::thread::hardware_concurrency();
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(new Worker);
+    }
+    for (int i = 0; i < numWorkers; ++i) {
+        Worker &w = *workers[i];
+        w.thread = std::thread([this, &w] { workerLoop(w); });
+#ifdef __linux__
+        if (pinThreads && numCores > 1) {
+            // spread workers over the cores after the first.
+            // (the calling thread isn't pinned; the scheduler places it)
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(1 + (i % (numCores - 1)), &cpus);
+            pthread_setaffinity_np(w.thread.native_handle(), sizeof(cpus), &cpus);
+        }
+#else
+        (void)pinThreads;
+        (void)numCores;
+#endif
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    quit = true;
+    for (auto &w : workers) {
+        if (w->parked.exchange(false)) {
+            w->wake.post();
+        }
+    }
+    for (auto &w : workers) {
+        w->thread.join();
+    }
+}
+
+void WorkerPool::run(int n, TaskFn f, void *ctx) {
+    if (!schedMatched) {
+        parallel = matchScheduling();
+        schedMatched = true;
+    }
+    if (!parallel) {
+        for (int i = 0; i < n; ++i) {
+            f(ctx, i);
+        }
+        return;
+    }
+    // (only this thread changes the generation)
+    const unsigned int g = generation.load(std::memory_order_relaxed) + 1;
+    fn.store(f, std::memory_order_relaxed);
+    context.store(ctx, std::memory_order_relaxed);
+    remaining.store(n, std::memory_order_relaxed);
+    // tasks are published before the generation, so woken workers find them
+    claim.store(packClaim(g, n), std::memory_order_release);
+    generation.store(g, std::memory_order_release);
+    for (auto &w : workers) {
+        if (w->parked.exchange(false)) {
+            w->wake.post();
+        }
+    }
+    runTasks();
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+bool WorkerPool::matchScheduling() {
+#if defined(__linux__) || defined(__APPLE__)
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) {
+        return false;
+    }
+    for (auto &w : workers) {
+        if (pthread_setschedparam(w->thread.native_handle(), policy, &param) != 0) {
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void WorkerPool::runTasks() {
+    uint64_t c = claim.load(std::memory_order_acquire);
+    for (;;) {
+        const int task = static_cast<int>(c & 0xffff);
+        if (task >= static_cast<int>((c >> 16) & 0xffff)) {
+            return;
+        }
+        // a claim made with a word from an earlier run fails here, since the generation differs
+        if (claim.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // the run can't end (and fn and context can't change) until this task is done
+            fn.load(std::memory_order_relaxed)(context.load(std::memory_order_relaxed), task);
+            remaining.fetch_sub(1, std::memory_order_release);
+            c = claim.load(std::memory_order_acquire);
+        }
+    }
+}
+
+void WorkerPool::workerLoop(Worker &w) {
+    unsigned int seen = generation.load(std::memory_order_acquire);
+    while (!quit) {
+        int spins = 0;
+        while (generation.load(std::memory_order_acquire) == seen && !quit) {
+            if (++spins < spinCount) {
+                continue;
+            }
+            // park; check again after announcing it, so a wakeup can't be missed
+            w.parked.store(true);
+            if (generation.load(std::memory_order_acquire) != seen || quit) {
+                if (w.parked.exchange(false)) {
+                    break;
+                }
+                // the waker already cleared the flag, and will post
+            }
+            w.wake.wait();
+            spins = 0;
+        }
+        seen = generation.load(std::memory_order_acquire);
+        runTasks();
+    }
+}